@@ -1,196 +1,624 @@
-/*
-//  Copyright (c) 2020 Peter Frane Jr. All Rights Reserved.
-//
-//  Use of this source code is governed by the GPL v. 3.0 license that can be
-//  found in the LICENSE file.
-//
-//  This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
-//  OF ANY KIND, either express or implied.
-//
-//  For inquiries, email the author at pfranejr AT hotmail.com
-*/
-
-#include "classes.h"
-#include <stdio.h>
-
-Buffer::Buffer()
-{
-	m_buf   = NULL;
-	m_index = 0;
-	m_size  = 0;
-}
-
-Buffer::~Buffer()
-{
-	destroy();
-}
-
-void Buffer::destroy()
-{
-	if( m_buf != NULL )
-		free( m_buf );
-
-	m_buf   = NULL;
-	m_index = 0;
-}
-
-void Buffer::setlength( size_t len )
-{
-	char *tmp = (char *) realloc( m_buf, len + 1 );
-
-	if( tmp != NULL )
-	{
-		m_buf = tmp;
-
-		m_size = len;
-		if( m_index > len )	// truncated
-		{
-			m_index = len;
-		}
-		else
-		{			
-			ZeroMemory( &m_buf[ m_index ], ( len - m_index ) );
-		}
-	}
-	else
-		throw ex_out_of_memory;
-}
-
-size_t  Buffer::length()
-{
-	return m_index;
-}
-
-void Buffer::format( const char *fmt, ... )
-{
-	va_list list;
-	size_t len;
-	char s[256];
-
-	va_start( list, fmt );
-	len = vsprintf_s( s, sizeof( s ) - 1, fmt, list );
-	//len = vsprintf( s, fmt, list );
-	va_end( list );
-	_write( m_index, s, len );
-}
-
-
-void Buffer::_write( size_t index, const char *s, size_t len )
-{
-	if( !s || ( len <= 0 ) )
-	{
-		return;
-	}
-
-	if( ( m_size - m_index ) <= len	)
-	{
-		setlength( m_size + len + 1);
-		
-	}
-
-	memcpy( &m_buf[ index ], s, len );
-
-	
-	m_index += len;
-}
-
-
-void Buffer::write( const char *s, size_t len )
-{
-	_write( m_index, s, len );
-}
-
-void Buffer::write( const char *s )
-{
-	_write( m_index, s, strlen( s ) );
-}
-
-char *Buffer::data( size_t *len )
-{
-	if( len != NULL )
-	{
-		*len = m_index;
-	}
-
-	return m_buf;
-}
-
-
-void Buffer::append( Buffer &buf, bool transfer )
-{
-	if( transfer && m_index == 0 )
-	{
-		BufferStruct temp;
-
-		buf.releaseBuffer( temp );
-
-		m_buf   = temp.m_buf;
-		m_index = temp.m_index;
-		m_size  = temp.m_size;
-	}
-	else
-	{
-		_write( m_index, buf.m_buf, buf.m_index );
-	}
-}
-
-void Buffer::releaseBuffer( BufferStruct &buf )
-{
-	buf.m_buf   = m_buf;
-	buf.m_index = m_index;
-	buf.m_size  = m_size;
-	
-	m_size  = 0;
-	m_index = 0;	
-	m_buf   = NULL;
-}
-
-void Buffer::reset()
-{
-	ZeroMemory( m_buf, m_index );	
-	m_index  = 0;
-}
-
-char *Buffer::release()
-{
-	char *temp;
-
-	temp    = m_buf;
-	m_size  = 0;
-	m_index = 0;	
-	m_buf   = NULL;
-
-	return temp;
-}
-
-void Buffer::insertAt( size_t index, const char *s )
-{
-	size_t len, count;
-	char *src, *dest;
-
-	len = strlen( s );
-
-	if( len == 0 )
-	  return;
-
-	if( index >= m_index )
-	{
-		_write( index, s, len );
-		return;
-	}
-
-	if( ( m_size - m_index ) <= len	)
-	{
-		setlength( m_size + len + 1);		
-	}
-	src = m_buf + index;
-	dest = src + len;
-	
-	count = m_index - index;
-	
-	//memmove_s( dest, m_size, src, count );
-
-	memmove( dest, src, count );	
-	memcpy( m_buf + index, s, len );
-	m_index += len;
-}
+/*
+//  Copyright (c) 2020 Peter Frane Jr. All Rights Reserved.
+//
+//  Use of this source code is governed by the GPL v. 3.0 license that can be
+//  found in the LICENSE file.
+//
+//  This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+//  OF ANY KIND, either express or implied.
+//
+//  For inquiries, email the author at pfranejr AT hotmail.com
+*/
+
+#include "classes.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+enum { ARENA_BLOCK_SIZE = 64 * 1024, ARENA_HUGE_PAGE_SIZE = 2 * 1024 * 1024, ARENA_ALIGN = 8 };
+
+struct ArenaBlock {
+	ArenaBlock *next;
+	size_t size;		// usable bytes after the header
+	bool hugePages;
+};
+
+static ArenaBlock *newBlock( size_t len, bool hugePages )
+{
+	ArenaBlock *block;
+	size_t size;
+
+	size = len + sizeof( ArenaBlock );
+	block = NULL;
+
+	if( hugePages )
+	{
+		size = ( size + ARENA_HUGE_PAGE_SIZE - 1 ) & ~( (size_t) ARENA_HUGE_PAGE_SIZE - 1 );
+
+#ifdef _WIN32
+		// needs the 'Lock pages in memory' privilege; falls back to malloc
+		block = (ArenaBlock *) VirtualAlloc( NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE );
+#else
+		void *p;
+
+		if( posix_memalign( &p, ARENA_HUGE_PAGE_SIZE, size ) == 0 )
+		{
+#ifdef MADV_HUGEPAGE
+			madvise( p, size, MADV_HUGEPAGE );
+#endif
+			block = (ArenaBlock *) p;
+		}
+#endif
+	}
+
+	if( block != NULL )
+	{
+		block->hugePages = true;
+	}
+	else
+	{
+		block = (ArenaBlock *) malloc( size );
+
+		if( block == NULL )
+		{
+			throw ex_out_of_memory;
+		}
+		block->hugePages = false;
+	}
+
+	block->next = NULL;
+	block->size = size - sizeof( ArenaBlock );
+
+	return block;
+}
+
+static void freeBlock( ArenaBlock *block )
+{
+#ifdef _WIN32
+	if( block->hugePages )
+	{
+		VirtualFree( block, 0, MEM_RELEASE );
+		return;
+	}
+#endif
+	free( block );
+}
+
+Arena::Arena( bool hugePages )
+{
+	m_first	    = NULL;
+	m_current   = NULL;
+	m_pos	    = NULL;
+	m_end	    = NULL;
+	m_last	    = NULL;
+	m_hugePages = hugePages;
+}
+
+Arena::~Arena()
+{
+	destroy();
+}
+
+void Arena::destroy()
+{
+	ArenaBlock *block, *next;
+
+	for( block = m_first; block != NULL; block = next )
+	{
+		next = block->next;
+		freeBlock( block );
+	}
+
+	m_first	  = NULL;
+	m_current = NULL;
+	m_pos	  = NULL;
+	m_end	  = NULL;
+	m_last	  = NULL;
+}
+
+// make room for 'len' bytes, reusing the blocks kept by reset() first
+
+void Arena::nextBlock( size_t len )
+{
+	ArenaBlock *block;
+	size_t size;
+
+	if( m_current != NULL && m_current->next != NULL && m_current->next->size >= len )
+	{
+		block = m_current->next;
+	}
+	else
+	{
+		size = ( m_current != NULL ) ? m_current->size * 2 : (size_t) ARENA_BLOCK_SIZE;
+
+		if( size < len )
+		{
+			size = len;
+		}
+
+		block = newBlock( size, m_hugePages );
+
+		if( m_current == NULL )
+		{
+			m_first = block;
+		}
+		else
+		{
+			block->next = m_current->next;
+			m_current->next = block;
+		}
+	}
+
+	m_current = block;
+	m_pos	  = (char *) ( block + 1 );
+	m_end	  = m_pos + block->size;
+}
+
+void *Arena::alloc( size_t len )
+{
+	char *p;
+
+	len = ( len + ARENA_ALIGN - 1 ) & ~( (size_t) ARENA_ALIGN - 1 );
+
+	if( (size_t) ( m_end - m_pos ) < len )
+	{
+		nextBlock( len );
+	}
+
+	p	   = m_pos;
+	m_pos += len;
+	m_last = p;
+
+	return p;
+}
+
+// the last allocation is grown in place; anything else is copied
+
+void *Arena::resize( void *p, size_t oldLen, size_t newLen )
+{
+	char *tmp;
+
+	if( p == m_last )
+	{
+		size_t len = ( newLen + ARENA_ALIGN - 1 ) & ~( (size_t) ARENA_ALIGN - 1 );
+
+		if( (size_t) ( m_end - m_last ) >= len )
+		{
+			m_pos = m_last + len;
+			return p;
+		}
+	}
+
+	tmp = (char *) alloc( newLen );
+
+	memcpy( tmp, p, ( oldLen < newLen ) ? oldLen : newLen );
+
+	return tmp;
+}
+
+// nothing allocated before the mark may grow in place past it, or a
+// rewind would take back part of it
+
+ArenaMark Arena::mark()
+{
+	ArenaMark mark;
+
+	mark.block = m_current;
+	mark.pos   = m_pos;
+	m_last	   = NULL;
+
+	return mark;
+}
+
+void Arena::rewind( const ArenaMark &mark )
+{
+	if( mark.block == NULL )
+	{
+		reset();
+		return;
+	}
+
+	m_current = mark.block;
+	m_pos	  = mark.pos;
+	m_end	  = (char *) ( mark.block + 1 ) + mark.block->size;
+	m_last	  = NULL;
+}
+
+void Arena::reset()
+{
+	m_current = NULL;
+	m_last	  = NULL;
+
+	if( m_first != NULL )
+	{
+		m_current = m_first;
+		m_pos	  = (char *) ( m_first + 1 );
+		m_end	  = m_pos + m_first->size;
+	}
+}
+
+Buffer::Buffer( Arena *arena )
+{
+	m_arena = arena;
+	m_buf   = m_small;
+	m_index = 0;
+	m_size  = BUFFER_SMALL_SIZE - 1;
+
+	m_small[0] = '\0';
+}
+
+Buffer::~Buffer()
+{
+	destroy();
+}
+
+void Buffer::destroy()
+{
+	if( !isSmall() && ( m_arena == NULL ) )
+		free( m_buf );
+
+	m_buf   = m_small;
+	m_index = 0;
+	m_size  = BUFFER_SMALL_SIZE - 1;
+
+	m_small[0] = '\0';
+}
+
+void Buffer::setlength( size_t len )
+{
+	char *tmp;
+
+	if( isSmall() )
+	{
+		if( len < BUFFER_SMALL_SIZE )
+		{
+			tmp = m_buf;
+		}
+		else
+		{
+			tmp = ( m_arena != NULL ) ? (char *) m_arena->alloc( len + 1 ) : (char *) malloc( len + 1 );
+
+			if( tmp != NULL )
+			{
+				memcpy( tmp, m_small, m_index + 1 );
+			}
+		}
+	}
+	else if( m_arena != NULL )
+	{
+		tmp = (char *) m_arena->resize( m_buf, m_size + 1, len + 1 );
+	}
+	else
+	{
+		tmp = (char *) realloc( m_buf, len + 1 );
+	}
+
+	if( tmp != NULL )
+	{
+		m_buf = tmp;
+
+		m_size = len;
+		if( m_index > len )	// truncated
+		{
+			m_index = len;
+			m_buf[ m_index ] = '\0';
+		}
+	}
+	else
+		throw ex_out_of_memory;
+}
+
+// grow by at least half the current size so that a series of appends
+// costs amortized constant time per byte
+
+void Buffer::reserve( size_t len )
+{
+	size_t newSize;
+
+	if( len <= m_size )
+	{
+		return;
+	}
+
+	newSize = m_size + m_size / 2;
+
+	if( newSize < len )
+	{
+		newSize = len;
+	}
+
+	setlength( newSize );
+}
+
+size_t  Buffer::length()
+{
+	return m_index;
+}
+
+void Buffer::_write( size_t index, const char *s, size_t len )
+{
+	if( !s || ( len <= 0 ) )
+	{
+		return;
+	}
+
+	if( ( m_size - m_index ) < len	)
+	{
+		reserve( m_index + len );
+	}
+
+	memcpy( &m_buf[ index ], s, len );
+
+	
+	m_index += len;
+	m_buf[ m_index ] = '\0';
+}
+
+
+void Buffer::write( const char *s, size_t len )
+{
+	_write( m_index, s, len );
+}
+
+void Buffer::write( const char *s )
+{
+	_write( m_index, s, strlen( s ) );
+}
+
+void Buffer::write( char c )
+{
+	_write( m_index, &c, 1 );
+}
+
+// room for 'len' more bytes at the end, counted as written; the caller
+// fills them
+
+char *Buffer::extend( size_t len )
+{
+	char *p;
+
+	reserve( m_index + len );
+
+	p		 = &m_buf[ m_index ];
+	m_index += len;
+	m_buf[ m_index ] = '\0';
+
+	return p;
+}
+
+char *Buffer::data( size_t *len )
+{
+	if( len != NULL )
+	{
+		*len = m_index;
+	}
+
+	return m_buf;
+}
+
+void Buffer::reset()
+{
+	m_index  = 0;
+	m_buf[0] = '\0';
+}
+
+
+MathNode *newNode( Arena &arena, node_type type, const char *text, size_t len )
+{
+	MathNode *node = (MathNode *) arena.alloc( sizeof( MathNode ) );
+
+	node->type	  = type;
+	node->text	  = text;
+	node->len	  = (unsigned int) len;
+	node->textOff = "";
+	node->lenOff  = 0;
+	node->first	  = NULL;
+	node->last	  = NULL;
+	node->next	  = NULL;
+	node->count	  = 0;
+
+	return node;
+}
+
+void addChild( MathNode *parent, MathNode *child )
+{
+	if( parent->last != NULL )
+	{
+		parent->last->next = child;
+	}
+	else
+	{
+		parent->first = child;
+	}
+	parent->last = child;
+	++parent->count;
+}
+
+// 'node' becomes the first child of 'wrapper', which takes its place in
+// the tree; the parent of the node needn't be known. What 'wrapper'
+// points to is not used afterwards
+
+void wrapNode( Arena &arena, MathNode *node, MathNode *wrapper )
+{
+	MathNode *inner, *next;
+
+	inner  = (MathNode *) arena.alloc( sizeof( MathNode ) );
+	*inner = *node;
+	next   = node->next;
+
+	inner->next = wrapper->first;
+	*node		= *wrapper;
+	node->next	= next;
+	node->first = inner;
+
+	if( node->last == NULL )
+	{
+		node->last = inner;
+	}
+	++node->count;
+}
+
+
+// trees nest as deeply as the formula, so the walk over them keeps its
+// own stack instead of recursing on the thread's
+
+enum { WALK_SMALL_SIZE = 32 };
+
+template <class T> struct WalkStack {
+	T m_small[WALK_SMALL_SIZE];
+	T *m_items;
+	size_t m_count, m_size;
+	WalkStack() : m_items( m_small ), m_count( 0 ), m_size( WALK_SMALL_SIZE ) {}
+	~WalkStack() { if( m_items != m_small ) free( m_items ); }
+	bool empty() { return m_count == 0; }
+	T &top() { return m_items[ m_count - 1 ]; }
+	void pop() { --m_count; }
+	T &push();
+private:
+	WalkStack( const WalkStack & );
+	WalkStack &operator=( const WalkStack & );
+};
+
+template <class T> T &WalkStack<T>::push()
+{
+	T *tmp;
+
+	if( m_count == m_size )
+	{
+		tmp = (T *) malloc( m_size * 2 * sizeof( T ) );
+
+		if( tmp == NULL )
+		{
+			throw ex_out_of_memory;
+		}
+		memcpy( tmp, m_items, m_count * sizeof( T ) );
+
+		if( m_items != m_small )
+		{
+			free( m_items );
+		}
+
+		m_items = tmp;
+		m_size *= 2;
+	}
+
+	return m_items[ m_count++ ];
+}
+
+/*
+
+ SERIALIZING: one walk over the tree either adds up the length of the
+ output or writes it, so the exact size is known before anything is
+ written. Besides the tags the nodes hold, the walk writes the <mrow>
+ of a row of more than one element and the separators of a table
+
+*/
+
+static const char rowOn[]	  = "<mrow>";
+static const char rowOff[]	  = "</mrow>";
+static const char rowSep[]	  = "</mtd></mtr><mtr><mtd>";
+static const char columnSep[] = "</mtd><mtd>";
+
+struct LengthWriter {
+	size_t len;
+	void put( const char *, size_t n ) { len += n; }
+};
+
+struct TextWriter {
+	char *dest;
+	void put( const char *s, size_t n ) { memcpy( dest, s, n ); dest += n; }
+};
+
+template <class Writer> static void walkTree( const MathNode *node, Writer &out )
+{
+	WalkStack<const MathNode *> parents;
+
+	for( ;; )
+	{
+		if( node->type == nt_row )
+		{
+			if( node->count > 1 )
+			{
+				out.put( rowOn, sizeof( rowOn ) - 1 );
+			}
+		}
+		else if( node->len != 0 )
+		{
+			out.put( node->text, node->len );
+		}
+
+		if( node->first != NULL )
+		{
+			parents.push() = node;
+			node = node->first;
+			continue;
+		}
+
+		// the end of the node, and of each parent it is the last child of
+
+		for( ;; )
+		{
+			if( node->type == nt_row )
+			{
+				if( node->count > 1 )
+				{
+					out.put( rowOff, sizeof( rowOff ) - 1 );
+				}
+			}
+			else if( node->lenOff != 0 )
+			{
+				out.put( node->textOff, node->lenOff );
+			}
+
+			if( parents.empty() )
+			{
+				return;
+			}
+
+			if( node->next != NULL )
+			{
+				switch( parents.top()->type )
+				{
+				case nt_table:
+					out.put( rowSep, sizeof( rowSep ) - 1 );
+					break;
+				case nt_table_row:
+					out.put( columnSep, sizeof( columnSep ) - 1 );
+					break;
+				default:
+					break;
+				}
+				node = node->next;
+				break;
+			}
+
+			node = parents.top();
+			parents.pop();
+		}
+	}
+}
+
+size_t treeLength( const MathNode *node )
+{
+	LengthWriter out = { 0 };
+
+	walkTree( node, out );
+
+	return out.len;
+}
+
+// returns the end of what was written; no null is added
+
+char *writeTree( const MathNode *node, char *dest )
+{
+	TextWriter out = { dest };
+
+	walkTree( node, out );
+
+	return out.dest;
+}
@@ -1,54 +1,132 @@
-/*
-//  Copyright (c) 2020 Peter Frane Jr. All Rights Reserved.
-//
-//  Use of this source code is governed by the GPL v. 3.0 license that can be
-//  found in the LICENSE file.
-//
-//  This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
-//  OF ANY KIND, either express or implied.
-//
-//  For inquiries, email the author at pfranejr AT hotmail.com
-*/
-
-#ifndef __classes
-#define __classes
-
-#include <memory.h>
-#include <stdarg.h>
-#include <malloc.h>
-#include <string.h>
-#include "exceptions.h"
-
-#ifndef ZeroMemory
-#define ZeroMemory(p,n) memset( (p), 0, (n) )
-#endif
-
-
-
-struct BufferStruct {
-	char *m_buf;
-	size_t m_index, m_size;
-};
-
-struct Buffer {
-	char *m_buf;
-	size_t m_index, m_size;
-    Buffer();
-	~Buffer();
-	void setlength( size_t len );
-	void write( const char *s, size_t len );
-	void write( const char *s );
-	size_t  length();
-	void append( Buffer &buf, bool transfer = false );
-	char *data( size_t *len = NULL );
-	void insertAt( size_t index, const char *s );
-	void format( const char *fmt, ... );
-	void releaseBuffer( BufferStruct &buf );
-	void reset();
-	char *release();
-	void destroy();
-private:
-	void _write( size_t index, const char *s, size_t len );
-};
-
+/*
+//  Copyright (c) 2020 Peter Frane Jr. All Rights Reserved.
+//
+//  Use of this source code is governed by the GPL v. 3.0 license that can be
+//  found in the LICENSE file.
+//
+//  This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+//  OF ANY KIND, either express or implied.
+//
+//  For inquiries, email the author at pfranejr AT hotmail.com
+*/
+
+#ifndef __classes
+#define __classes
+
+#include <memory.h>
+#include <malloc.h>
+#include <string.h>
+#include "exceptions.h"
+
+#ifndef ZeroMemory
+#define ZeroMemory(p,n) memset( (p), 0, (n) )
+#endif
+
+
+
+// bump allocator for the scratch memory of one conversion; nothing is
+// freed individually, reset() takes back everything at once and keeps
+// the blocks for the next conversion
+
+struct ArenaBlock;
+
+// how far the arena had handed out memory; rewind() takes back what was
+// allocated after the mark and keeps the blocks, like reset()
+
+struct ArenaMark {
+	ArenaBlock *block;
+	char *pos;
+};
+
+struct Arena {
+	Arena( bool hugePages = false );
+	~Arena();
+	void *alloc( size_t len );
+	void *resize( void *p, size_t oldLen, size_t newLen );
+	ArenaMark mark();
+	void rewind( const ArenaMark &mark );
+	void reset();
+	void destroy();
+private:
+	Arena( const Arena & );
+	Arena &operator=( const Arena & );
+	void nextBlock( size_t len );
+	ArenaBlock *m_first, *m_current;
+	char *m_pos, *m_end, *m_last;
+	bool m_hugePages;
+};
+
+// short fragments (a tag, a word of text) are kept in m_small and never
+// touch the heap; larger ones grow the heap block geometrically
+
+enum { BUFFER_SMALL_SIZE = 64 };
+
+struct Buffer {
+	char *m_buf;
+	size_t m_index, m_size;
+	char m_small[BUFFER_SMALL_SIZE];
+	Arena *m_arena;		// where the heap block comes from; NULL = malloc
+    Buffer( Arena *arena = NULL );
+	~Buffer();
+	void setlength( size_t len );
+	void reserve( size_t len );
+	void write( const char *s, size_t len );
+	void write( const char *s );
+	void write( char c );
+	// a string literal: its length is known at compile time
+	template <size_t N> void writeLiteral( const char (&s)[N] ) { _write( m_index, s, N - 1 ); }
+	char *extend( size_t len );
+	size_t  length();
+	char *data( size_t *len = NULL );
+	void reset();
+	void destroy();
+private:
+	Buffer( const Buffer & );
+	Buffer &operator=( const Buffer & );
+	bool isSmall() { return m_buf == m_small; }
+	void _write( size_t index, const char *s, size_t len );
+};
+
+// the parse builds a tree of nodes in the arena; writeTree() writes it
+// out once the conversion is done. A token holds its markup, an element
+// its start and end tags with its children in between. Putting a base
+// in a script, or a group in an <mrow>, changes the tree and not text
+// already written
+
+enum node_type {
+	nt_identifier,		// <mi>
+	nt_number,			// <mn>
+	nt_operator,		// <mo>: a symbol, an entity, a prime
+	nt_function,		// \sin and the like, with the function application
+	nt_text,			// a run of \text, \ms or \eqno
+	nt_space,			// \strut and the other empty elements
+	nt_error,			// source that recovery mode skipped, as an <merror>
+	nt_row,				// its children, in an <mrow> if there is more than one
+	nt_list,			// its children, with no tags of its own
+	nt_script,			// a base and its scripts or limits
+	nt_fraction,		// \frac, \binom, \cfrac, ...
+	nt_root,			// \sqrt
+	nt_fence,			// \left ... \right
+	nt_table,			// an environment; its children are its rows
+	nt_table_row,		// its children are its cells
+	nt_cell,			// the elements of a cell
+	nt_element			// any other command: an accent, \overbrace, \phantom, ...
+};
+
+struct MathNode {
+	const char *text;		// a token's markup, or an element's start tag
+	const char *textOff;	// an element's end tag
+	MathNode *first, *last;	// the children
+	MathNode *next;			// the next child of the same parent
+	unsigned int len, lenOff;
+	unsigned int count;		// of children
+	node_type type;
+};
+
+MathNode *newNode( Arena &arena, node_type type, const char *text = "", size_t len = 0 );
+void addChild( MathNode *parent, MathNode *child );
+void wrapNode( Arena &arena, MathNode *node, MathNode *wrapper );
+size_t treeLength( const MathNode *node );
+char *writeTree( const MathNode *node, char *dest );
+
 #endif
\ No newline at end of file
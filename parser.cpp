@@ -1,2375 +1,4547 @@
-/*
-//  Copyright (c) 2020 Peter Frane Jr. All Rights Reserved.
-//
-//  Use of this source code is governed by the GPL v. 3.0 license that can be
-//  found in the LICENSE file.
-//
-//  This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
-//  OF ANY KIND, either express or implied.
-//
-//  For inquiries, email the author at pfranejr AT hotmail.com
-*/
-
-#include "tex2mml.h"
-#include "classes.h"
-#include "tables.h"
-#include "exceptions.h"
-#include <ctype.h>
-// GLOBALS
-
-
-enum sub_expression { se_none, se_use_default, se_braced, se_optional_param, se_inline_math, se_fence,					 
-					  se_matrix };//, se_eqalign, se_array, se_eqnarray  };
-
-enum element_type { et_unknown, et_tag_off, et_tag_on, et_tag_open, et_tag_on_open };
-
-
-enum skip_input { sp_skip_all, sp_skip_once, sp_no_skip };
-
-enum { MAX_CONTROL_NAME = 32, EXTRA_BUF = 8 };
-
-
-#define char_null	   '\0'
-#define char_backslash '\\'
-#define char_prime	   '\''
-
-
-struct ArrayStruct {
-	short maxColumn, columnCount;
-	//sub_expression subType;
-	command_id id;
-};
-
-struct ErrorMessage {
-	const char *msg;
-	int index;
-	int code;	
-	string msg2;
-};
-
-struct InputStream {
-	token_type token;
-	char buffer[MAX_CONTROL_NAME+EXTRA_BUF+1];
-	char *start;
-	char nextChar;
-};
-
-
-static SymbolTable limits[] = {
-	{ "<munder>", "</munder>" },
-	{ "<mover>", "</mover>" },
-	{ "<munderover>", "</munderover>" }
-};
-
-static SymbolTable nolimits[] = {
-	{ "<msub>", "</msub>" },
-	{ "<msup>", "</msup>" },
-	{ "<msubsup>", "</msubsup>" }
-};
-
-static SymbolTable limitsMovable[] = {
-	{ "<msub movablelimits='true'>", "</msub>" },
-	{ "<msup movablelimits='true'>", "</msup>" },
-	{ "<msubsup movablelimits='true'>", "</msubsup>" }
-};
-
-static char *pStart		= NULL;
-static char *pCur 		= NULL;
-static char *pEnd		= NULL;
-static bool isNumberedFormula = false;
-static Buffer globalBuf, eqNumber;
-static ErrorMessage errMsg;
-
-
-void onDigit( Buffer &prevBuf );
-void onAlpha( Buffer &prevBuf );
-void onSymbol( Buffer &prevBuf, InputStream &input, bool checkSubSup = true );
-void onSubscript( Buffer &prevBuf );
-void onSuperscript( Buffer &prevBuf );
-void onControlName( Buffer &prevBuf, InputStream &input, bool &quit );
-void onEntity( Buffer &prevBuf, EntityStruct *entity, bool checkLimits = true, bool checkSubSup = true );
-void onFunction( Buffer &prevBuf, FunctionStruct *function, bool checkLimits = true );
-bool onCommand( Buffer &prevBuf, ControlStruct &control, sub_expression subType, void *paramExtra );
-void getCommandParam( Buffer &prevBuf, sub_expression subType );
-bool followedBy( char **p, const char *pattern, skip_input skip );
-bool parseExpression(const char *input, int len, int *errorIndex, int *errCode );
-void runLoop( Buffer &prevBuf, sub_expression subType, void *paramExtra = NULL );
-EnvironmentStruct *getEnvironmentType();
-void onBeginEnvironment( Buffer &prevBuf );
-bool onEndEnvironment( sub_expression subType, void *paramExtra );
-void precondition( char **p );
-void skipSpaces( char **p );
-void skipChar( char **p );
-bool getInput( InputStream &input, skip_input white_space );
-bool scriptNext( char *p );
-int  getLastTagIndex(const char *p, size_t length, element_type element );
-token_type getControlTypeEx( InputStream &input, ControlStruct &control );
-void onColumn( Buffer &prevBuf, const char *pos, ArrayStruct &ar );
-void onRow( Buffer &prevBuf, ArrayStruct &ar );
-bool needsMrow(const char *p );
-void onMathFont( Buffer &prevBuf, const char *tagOn, const char *tagOff );
-void onTextFont( Buffer &prevBuf, const char *tagOn, const char *tagOff, command_id id, bool allowInline = true );
-bool onFence( Buffer &prevBuf, command_id id, sub_expression subType, const char *tagOn, const char *tagOff );
-void onEndExpression( sub_expression subType, token_type token, CommandStruct *command );
-void getPrime( char **p, char *buf );
-void onPrime( Buffer &prevBuf );
-
-bool convertFormula(const char *input, int len, int *errorIndex, int *errCode )
-{
-	
-	if( len < 0 )
-	{
-		len = (int) strlen( input );
-	}
-
-	if( len == 0 )
-	{
-		return false;
-	}
-
-	return parseExpression( input, len, errorIndex, errCode );	
-}
-
-bool parseExpression( const char *input, int len, int *errorIndex, int *errCode )
-{
-	
-	bool result;
-
-	pStart	  = (char *)input;
-	pCur	  = pStart;
-	pEnd      = pStart + len;	
-
-	ZeroMemory( &errMsg, sizeof( errMsg ) );
-
-	globalBuf.destroy();
-	eqNumber.destroy();
-	isNumberedFormula = false;
-
-	result = true;
-	try 
-	{
-		precondition( &pCur );
-		runLoop( globalBuf, se_use_default );
-		if( needsMrow( globalBuf.data() ) )
-		{
-			globalBuf.insertAt( 0, "<mrow>" );
-			globalBuf.write( "</mrow>" );
-		}
-		if( isNumberedFormula )
-		{
-			globalBuf.insertAt( 0, eqNumber.data() );
-			globalBuf.write( "</mtd></mlabeledtr></mtable>" );
-		}
-	}
-	catch( const ErrorMessage &err )
-	{
-		result      = false;
-		*errCode    = err.code;
-		*errorIndex = err.index;
-	}
-
-	return result;
-}
-
-
-const char *getMathMLOutput()
-{
-	if( globalBuf.length() != 0 )
-	{
-		return globalBuf.data();
-	}
-
-	return NULL;
-}
-
-bool getMathMLOutput(string& buf, bool display)
-{
-	if (globalBuf.length() != 0)
-	{
-		const char *data = globalBuf.data();
-
-		buf = display ? "<math display='block'>" : "<math>";
-
-		buf.append(data);
-		buf.append("</math>");
-
-		return true;
-	}
-	return false;
-}
-static void getControlName(const char* start, string& name)
-{
-	char* p = (char*)(start+1);
-
-	name.push_back('\\');
-
-	if (!isalpha(*p))
-	{
-		name.push_back(*p);
-		return;
-	}
-	while (*p && isalnum(*p))
-	{
-		name.push_back(*p);
-		++p;
-	}
-}
-
-ErrorMessage &error(const char *index, ex_exception code )
-{
-	errMsg.code  = (int) code;
-	errMsg.index = (int) (index - pStart);	
-
-	if (ex_undefined_control_sequence == code)
-	{
-		string name;
-
-		errMsg.msg2 = getErrorMsg(code);
-		errMsg.msg2.append(": ");
-		
-		getControlName(index, name);
-		
-		errMsg.msg2.append(name);
-
-		errMsg.msg = errMsg.msg2.c_str();
-	}
-	else
-	{
-		errMsg.msg = getErrorMsg(code);
-	}
-	return errMsg;
-}
-
-ErrorMessage& error(const char* index, ex_exception code, const string &msg)
-{
-	errMsg.code = (int)code;
-	errMsg.index = (int)(index - pStart);
-	errMsg.msg = getErrorMsg(code);
-
-	return errMsg;
-}
-
-
-const char *getLastError()
-{
-	return errMsg.msg;
-}
-
-/*
-
- PRECONDITION traps as many errors as possible
-
-*/
-
-
-static void precondition( char **p )
-{
-	int braces;
-	char *s, *lastLeftBrace;
-
-	skipSpaces( p );
-
-	// these chars can't start an equation
-
-	//lastPos = *p;
-
-	s = *p;
-
-	switch( *s )
-	{
-	case '}':
-		throw error( s, ex_missing_lbrace );
-	case '^':
-		throw error( s, ex_prefix_superscript );
-	case '_':
-		throw error( s, ex_prefix_subscript );
-	case '&':
-		throw error( s, ex_misplaced_column_separator );		
-	}
-
-	braces = 0;
-	lastLeftBrace = NULL;
-
-	while( *s )
-	{
-		if( *s == '{' )
-		{
-			lastLeftBrace = s;
-			++braces;
-			skipChar( &s );			
-			if( *s == '}' )
-			{
-				skipChar( &s );
-				--braces;
-			}			
-			switch( *s )
-			{
-			case '^':
-				throw error( s, ex_prefix_superscript );
-			case '_':
-				throw error( s, ex_prefix_subscript );
-			}
-		}
-		else if( *s == '}' )
-		{
-			--braces;
-			if( braces < 0 )
-			{
-				throw error( s, ex_more_rbrace_than_lbrace );
-			}
-			++s;
-		}
-		else if( *s == char_backslash )
-		{
-			++s;
-			if( isdigit( *s ) )
-			{
-				throw error( s-1, ex_undefined_control_sequence );
-			}
-			else if( isalpha( *s ) )
-			{
-				char *start;
-
-				start = s;
-
-				// compute the length of the control name
-				do
-				{
-					++s;
-				} 
-				while( isalpha( *s ) );
-
-				if( ( s - start ) > MAX_CONTROL_NAME )
-				{
-					throw error( start - 1, ex_control_name_too_long );
-				}
-			}
-			else
-			{
-				// only the following chars can be escaped
-
-				switch( *s )
-				{		
-				case '}':
-				case '{':
-				case '&':
-				case '^':
-				case '_':
-				case '-':
-				case '$':
-				case '#':				
-				case '!':
-				case ';':
-				case '>':
-				case ':':	// check
-				case ',':
-				case '|':
-				case ' ':
-					++s;
-					break;
-				case char_backslash:
-					skipChar( &s );
-					if( scriptNext( s ) )
-					{
-						if( *s == '_' )
-						{
-							throw error( s, ex_prefix_subscript );
-						}
-						else
-						{
-							throw error( s, ex_prefix_superscript );
-						}
-					}
-					break;
-				default:
-					throw error( s-1, ex_undefined_control_sequence );				
-				}		
-			}
-		}
-		else if( *s == '&' )
-		{			
-			skipChar( &s );
-			if( scriptNext( s ) )
-			{
-				if( *s == '_' )
-				{					
-					throw error( s, ex_prefix_subscript );
-				}
-				else
-				{
-					throw error( s, ex_prefix_superscript );
-				}
-			}
-		}
-		else if( *s == '$' )
-		{
-			if( braces == 0 )
-			{
-				throw error( s, ex_misplaced_inline_formula );
-			}
-
-			skipChar( &s );
-			if( scriptNext( s ) )
-			{
-				if( *s == '_' )
-				{
-					throw error( s, ex_prefix_subscript );
-				}
-				else
-				{
-					throw error( s, ex_prefix_superscript );
-				}
-			}
-		}
-		else if( scriptNext( s ) )
-		{
-			char *pos;
-
-			pos = s;
-			skipChar( &s );
-			switch( *s )
-			{
-			case char_null:
-			case '}':
-			case '$':
-			case '&':
-				throw error( pos, ex_missing_parameter );				
-			case char_backslash:
-				if( s[1] == char_backslash ) // row separator
-				{
-					throw error( pos, ex_missing_parameter );
-				}				
-			}
-		}
-		else
-		{
-			++s;
-		}
-		
-	}
-
-	if( braces != 0 )
-	{
-		throw error( lastLeftBrace, ex_more_lbrace_than_rbrace );
-	}
-	// check backwards
-
-	do {
-		--s;
-	}
-	while( (s > *p ) && isspace( *s ) );
-
-	pEnd = s+1;	
-}
-
-static void skipSpaces( char **p )
-{
-	char *s;
-
-	if( p == NULL )
-	{
-		return;
-	}
-
-	s = *p;
-
-	while( (*s) && isspace( *s ) )
-	{
-		++s;
-	}
-
-	*p = s;
-}
-
-static void skipChar( char **p )
-{
-	char *s;
-
-	if( p == NULL )
-	{
-		return;
-	}
-
-	s = *p;
-
-	++s; // skip one char, then spaces
-
-	while( (*s) && isspace( *s ) )
-	{
-		++s;
-	}
-
-	*p = s;
-}
-
-
-static bool followedBy( char **p, const char *pattern, skip_input skip )
-{
-	char *s;
-
-	if( p == NULL )
-	{
-		return false;
-	}
-
-	s = *p;
-
-	do {
-		if( *s == *pattern )
-		{
-			++s;
-			++pattern;
-		}
-		else
-		{
-			return false;
-		}
-	} while( *s && *pattern );
-
-	if( ( *pattern == char_null ) && !isalpha( *s ) )
-	{
-		if( skip != sp_no_skip )
-		{
-			if( isspace( *s ) )
-			{
-				skipSpaces( &s );
-			}
-			*p = s;
-		}
-		return true;
-	}
-
-	return false;
-}
-
-
-static bool scriptNext( char *p )
-{
-	return ( *p == '_' ) || ( *p == '^' );
-}
-
-static int  getLastTagIndex( char *p, size_t length, element_type element )
-{
-	int inside;			// inside a tag
-	element_type current;
-	size_t i;
-
-	if( ( p == NULL ) || (length == 0) )
-	{
-		return -1;
-	}
-
-	i	    = length-1;
-	inside  = 0;
-    current = et_unknown;
-
-	while( i >= 0 )
-	{
-		if( p[i] == '>' )
-		{
-			if( p[i-1] == '/' )
-			{
-				current = et_tag_open;
-				--i;	// to skip twice
-			}
-		}
-		else if( p[i] == '<' )
-		{
-			if( p[i+1] == '/' )
-			{
-				current = et_tag_off;		
-				if( element == current )
-				{
-					return (int) i;
-				}
-				inside++;
-			}
-			else 
-			{
-				--inside;
-				if( inside == 0 )
-				{
-					return (int) i;
-				}
-			}
-		}
-		if( i == 0 )
-		{
-			break;
-		}
-		--i;
-	}
-
-	return -1;
-}
-
-static bool getInput( InputStream &input, skip_input white_space )
-{
-	
-	ZeroMemory( &input, sizeof( input ) );
-
-	if( white_space == sp_skip_all )
-	{
-		if( isspace( *pCur ) )
-		{
-			skipSpaces( &pCur );
-		}
-	}
-	
-	if( *pCur == char_null )
-	{
-		input.token = token_eof;
-		return false;
-	}
-
-	
-	while( *pCur )
-	{
-		input.start = pCur;
-		if( isalpha( *pCur ) )
-		{
-			input.token = token_alpha;
-			break;
-		}
-		else if( isdigit( *pCur ) )
-		{
-			input.token = token_digit;
-			break;
-		}
-		else if( *pCur == '&' )
-		{
-			input.token = token_column_sep;
-			skipChar( &pCur );
-			break;
-		}
-		else if( *pCur == '{' )
-		{
-			input.token = token_left_brace;
-			skipChar( &pCur );
-			break;
-		}
-		else if( *pCur == '}' )
-		{
-			input.token = token_right_brace;
-			skipChar( &pCur );
-			break;
-		}
-		else if( *pCur == '^' )
-		{
-			input.token = token_superscript;
-			skipChar( &pCur );
-			break;
-		}
-		else if( *pCur == '_' )
-		{
-			input.token = token_subscript;
-			skipChar( &pCur );
-			break;
-		}
-		else if( isspace( *pCur ) )
-		{
-			if( *pCur == ' ' )
-			{
-				if( white_space == sp_skip_all )
-				{
-				   skipSpaces( &pCur );
-				}
-				else if ( white_space == sp_skip_once )
-				{
-					
-					input.token = token_white_space;
-					++pCur;
-					break;
-				}
-				else
-				{
-					//input.token = token_white_space;
-					skipSpaces( &pCur );
-				}
-			}
-			else		// other spaces \n\r
-			{
-				skipSpaces( &pCur );
-			}
-		}
-		else if( *pCur == char_backslash )
-		{
-			++pCur;
-			if( isalpha( *pCur ) )
-			{
-				input.token = token_control_name;		
-				for( int i = 0; i < MAX_CONTROL_NAME; ++i )
-				{					
-					input.buffer[i] = *pCur;
-					++pCur;
-					if( !isalpha( *pCur ) )
-					{
-						break;
-					}
-				}
-				// use this to determine whether control name 
-				// is followed IMMEDIATELY by digits
-				// cf. \abc123 vs.\abc   123
-				input.nextChar = *pCur;
-				if( isspace( *pCur ) )
-				{
-					skipSpaces( &pCur );
-				}
-			}
-			else
-			{
-				if( *pCur == char_backslash )
-				{
-					input.token  = token_row_sep;
-				}
-				else
-				{
-					input.token  = token_control_symbol;
-				}
-				input.buffer[0] = char_backslash;
-				input.buffer[1] = *pCur;
-				skipChar( &pCur );				
-				input.nextChar = *pCur;
-			}
-			break;
-		}
-		else if( *pCur == ']' )
-		{			
-			input.token  = token_right_sq_bracket;
-			input.buffer[0] = *pCur;
-			skipChar( &pCur );				
-			input.nextChar = *pCur;
-			break;
-		}
-		else if( *pCur == '$' )
-		{			
-			input.token  = token_inline_math;
-			input.buffer[0] = *pCur;
-			//skipChar( &pCur ); don't skip
-			input.nextChar = *pCur;
-			break;
-		}
-		else if( *pCur == char_prime )
-		{
-			input.token  = token_prime;
-			input.buffer[0] = *pCur;			
-			input.nextChar = pCur[1];
-			// don't skip
-			break;
-		}
-		else	// symbols
-		{
-			input.token  = token_symbol;
-			input.buffer[0] = *pCur;
-			skipChar( &pCur );				
-			input.nextChar = *pCur;
-			break;
-		}
-	}
-
-	return true;
-}
-
-static void onPrime( Buffer &prevBuf )
-{
-	SymbolStruct *sym;
-	char buf[5];
-
-	getPrime( &pCur, buf );
-
-	sym = getSymbol( buf );
-	
-	prevBuf.write( sym->element );
-}
-
-static void getPrime( char **p, char *buf )
-{
-	int i = 0;
-	do {
-		*buf = **p;
-		++buf;
-		++(*p);
-		++i;
-		if( i == 3 )
-		{
-			break;
-		}
-	} while( **p == char_prime );
-
-	*buf = char_null;
-
-	if( isspace( *pCur ) )
-	{		
-		skipSpaces( &pCur );
-	}
-}
-
-static token_type getControlTypeEx( InputStream &input, ControlStruct &control )
-{
-	Buffer buf;		
-
-	control.start = input.start;
-	input.token		  = getControlType( input.buffer, control );
-
-	if( input.token != token_unknown )
-	{
-		return input.token;
-	}
-
-	if( isdigit( input.nextChar )  )
-	{
-		buf.write( input.buffer );	
-		buf.write( pCur, 1 );		// write the next digit
-		++pCur;
-	}
-	else
-	{
-		return input.token;
-	}
-
-	while( ( input.token = getControlType( buf.data(), control ) ) == token_unknown )
-	{
-		if( isdigit( *pCur ) )
-		{
-			buf.write( pCur, 1 );
-			++pCur;
-		}
-		else
-		{
-			break;
-		}
-	}
-
-	return input.token;
-}
-
-static void runLoop( Buffer &prevBuf, sub_expression subType, void *paramExtra )
-{
-	InputStream input;
-	ControlStruct control;	
-	Buffer str;
-	bool quitLoop;
-
-	ZeroMemory( &control, sizeof( control ) );
-
-	quitLoop = false;
-
-	while( getInput( input, sp_skip_all ) )
-	{
-		switch( input.token )
-		{
-		case token_alpha:
-			onAlpha( str );
-			break;
-
-		case token_digit:
-			onDigit( str );
-			break;
-
-		case token_prime:
-			onPrime( str );
-			break;
-		case token_symbol:
-		case token_control_symbol:		
-			onSymbol( str, input );
-			break;
-		/*
-		case token_white_space:
-			onWhiteSpace( str );
-			break;
-		*/
-		case token_inline_math:
-
-			if( subType != se_inline_math )
-			{
-				throw error( pCur, ex_misplaced_inline_formula );
-			}
-			quitLoop = true;
-			break;
-		case token_left_brace:
-			runLoop( str, se_braced );
-			break;
-		case token_right_brace:			
-			quitLoop = true;
-			break;
-		case token_right_sq_bracket:
-			if( subType == se_optional_param )
-			{
-				quitLoop = true;
-			}
-			else
-			{
-				onSymbol( str, input );
-			}
-			break;
-		case token_superscript:
-			onSuperscript( str );
-			break;
-		
-		case token_subscript:
-			onSubscript( str );
-			break;
-		
-		case token_column_sep:
-			if( subType < se_matrix )
-			{
-				throw error( input.start, ex_misplaced_column_separator );				
-			}
-			else
-			{
-				onColumn( str, input.start, *((ArrayStruct *)paramExtra) );
-			}
-			break;
-		case token_row_sep:
-			if( subType < se_matrix )
-			{
-				throw error( input.start, ex_misplaced_row_separator );				
-			}
-			else
-			{
-				onRow( str, *((ArrayStruct *)paramExtra) );
-			}
-			break;		
-		case token_control_name:
-			//onControlName( str, input, quit );			
-
-				input.token = getControlTypeEx( input, control );
-
-				switch( input.token )
-				{		
-				case token_control_entity:
-					onEntity( str, control.entity );
-					break;				
-				case token_control_command:
-					quitLoop = onCommand( str, control, subType, paramExtra );
-					break;
-				case token_control_function:
-					onFunction( str, control.function );
-					break;
-				//case token_unknown:
-				default:
-					throw error( input.start, ex_undefined_control_sequence );								
-				}
-
-			break;
-		}
-
-		if( quitLoop )
-		{
-			break;
-		}
-	}
-
-	onEndExpression( subType, input.token, control.command );
-
-	prevBuf.append( str, true );	
-}
-
-//se_optional_param, se_inline_math, se_fence,					 
-//					  se_matrix
-static void onEndExpression( sub_expression subType, token_type token, CommandStruct *command )
-{
-	switch( subType )
-	{
-	case se_optional_param:
-		if( token != token_right_sq_bracket )
-		{
-			throw error( pCur, ex_missing_right_sq_bracket );
-		}
-		break;
-	case se_inline_math:
-		if( token != token_inline_math )
-		{
-			throw error( pCur, ex_missing_dollar_symbol );
-		}
-		break;
-	case se_matrix:
-		if( token != token_control_command )
-		{
-			throw error( pCur, ex_missing_end );
-		}
-		else if( command->id != ci_end )
-		{
-			throw error( pCur, ex_missing_end );
-		}
-		break;
-	case se_fence:
-		if( token != token_control_command )
-		{
-			throw error( pCur, ex_missing_right_fence );
-		}
-		else if( command->id != ci_right )
-		{
-			throw error( pCur, ex_missing_right_fence );
-		}
-	}
-
-}
-
-
-static void onAlpha( Buffer &prevBuf )
-{
-	char tag[] = "<mi>?</mi>";
-	char *p;
-	Buffer str;
-
-
-	str.setlength( 50 );
-
-	p = strchr( tag, '?' );
-
-	do {
-		*p = *pCur;
-		str.write( tag, sizeof( tag ) - 1 );	
-		++pCur;
-	}
-	while( isalpha( *pCur ) );
-
-	prevBuf.append( str, true );	
-
-}
-
-static void onDigit( Buffer &prevBuf )
-{
-	char tagOn[] = "<mn>";
-	char tagOff[] = "</mn>";
-
-	Buffer str;
-	char *start;
-
-
-	str.setlength( 50 );
-
-
-	str.write(tagOn, sizeof( tagOn ) - 1 );
-
-
-	start = pCur;
-
-	do {		
-		++pCur;
-	}
-	while( isdigit( *pCur ) );
-
-	str.write( start, (pCur - start) );
-
-	str.write(tagOff, sizeof( tagOff ) - 1 );
-
-	prevBuf.append( str, true );
-
-}
-
-static void onSymbol( Buffer &prevBuf, InputStream &input, bool checkSubSup )
-{
-	SymbolStruct *symbol;
-
-	symbol = getSymbol( input.buffer );
-
-	if( symbol == NULL )
-	{
-		throw error( pCur, ex_unknown_character );
-	}
-
-	
-	switch( symbol->mathType )
-	{
-	case mt_fence:
-	case mt_left_fence:
-	case mt_right_fence:
-		if( checkSubSup && scriptNext( pCur ) )
-		{
-			throw error( pCur, ex_ambiguous_script );
-		}
-		break;
-	}
-
-	prevBuf.write( symbol->element );
-}
-
-static bool needsMrow( const char *p )
-{
-	element_type et;
-	short inside, count;
-
-	if( p == NULL )
-	{
-		return false;
-	}
-
-	inside = count = 0;
-	et	   = et_unknown;
-
-	while( *p )
-	{
-		if( *p == '<' )
-		{
-			if( p[1] == '/' )
-			{
-				et = et_tag_off;
-				++p;				
-			}
-			else
-			{
-				et = et_tag_on;
-			}
-		}
-		else if( *p == '>' )
-		{
-			if( *(p-1) == '/' ) // tag open
-			{
-				if( inside == 0 )
-				{
-					++count;
-				}
-			}
-			else if( et == et_tag_off ) 
-			{
-				--inside;
-			}
-			else
-			{
-				if( inside == 0 )
-				{
-					++count;
-				}
-				++inside;
-			}
-			if( count > 1 )
-			{
-				return true;
-			}
-		}
-		++p;
-	}
-
-	return false;
-}
-
-static void getCommandParam( Buffer &prevBuf, sub_expression subType )
-{
-	InputStream input;
-	Buffer str;
-	ControlStruct control;
-
-	getInput( input, sp_skip_all );
-
-	switch( input.token )
-	{
-	case token_alpha:
-		prevBuf.format( "<mi>%c</mi>", *pCur );
-		skipChar( &pCur );
-		break;
-
-	case token_digit:
-		prevBuf.format( "<mn>%c</mn>", *pCur );
-		skipChar( &pCur );
-		break;
-	case token_prime:
-		prevBuf.write( "<mo>&#x02032;</mo>" );
-		skipChar( &pCur );
-		break;
-	case token_symbol:
-	case token_control_symbol:
-		onSymbol( prevBuf, input, false ); // ignore subscript/superscript
-		break;
-
-	case token_left_brace:
-		if( subType == se_use_default )
-		{
-			runLoop( str, se_braced );
-		}
-		else
-		{
-			runLoop( str, subType );
-		}
-		if( needsMrow( str.data() ) )
-		{
-			str.insertAt( 0, "<mrow>" );
-			str.write( "</mrow>" );
-		}
-		prevBuf.append( str, true );
-		break;
-
-	case token_right_brace:			
-	case token_superscript:
-	case token_subscript:
-	case token_column_sep:
-	case token_row_sep:
-	case token_eof:
-		throw error( pCur, ex_missing_parameter );		
-
-	case token_control_name:
-			//onControlName( str, input, quit );			
-
-		input.token = getControlTypeEx( input, control );
-
-		switch( input.token )
-		{		
-		case token_control_entity:
-			// don't check limits and subscript
-			onEntity( prevBuf, control.entity, false, false );
-			break;				
-		case token_control_command:
-			if( control.command->id == ci_frac )
-			{
-				onCommand( str, control, se_use_default, NULL );
-				prevBuf.append( str, true );
-			}
-			else
-			{
-				throw error( input.start, ex_no_command_allowed );
-			}
-			break;
-		case token_control_function:
-			onFunction( prevBuf, control.function, false );
-			break;
-		//case token_unknown:
-		default:
-			throw error( input.start, ex_undefined_control_sequence );								
-		}
-		break;
-	default:
-		break;
-	}
-}
-
-static void getSuperscript( Buffer &prevBuf, bool subsup )
-{
-	if( *pCur == char_prime )
-	{
-		throw error( pCur, ex_missing_lbrace );
-	}
-
-	getCommandParam( prevBuf, se_use_default );
-
-	if( ( *pCur == '^' ) || ( *pCur == char_prime ) )
-	{
-		throw error( pCur, ex_double_superscript );
-	}
-	else if( *pCur == '_' )
-	{
-		if( subsup )
-		{
-			throw error( pCur, ex_double_subscript );
-		}
-		else
-		{
-			throw error( pCur, ex_use_subscript_before_superscript );
-		}
-	}
-}
-
-static void onSuperscript( Buffer &prevBuf )
-{
-	Buffer str;
-	int index;
-	SymbolTable *sup;
-	
-	sup = &nolimits[1];
-
-
-	index = getLastTagIndex( prevBuf.data(), prevBuf.length(), et_tag_on_open );
-
-	if( index < 0 )
-	{
-		throw error( pCur, ex_missing_subsup_base );
-	}
-	
-    str.setlength( 50 );
-
-	prevBuf.insertAt( index, sup->tagOn );	
-
-	getSuperscript( str, false );
-
-	str.write( sup->tagOff );		
-
-	prevBuf.append( str, true );
-}
-
-static void getSubscript( Buffer &prevBuf, command_id &which )
-{
-	
-	if( *pCur == char_prime )
-	{
-		throw error( pCur, ex_missing_lbrace );
-	}
-
-	getCommandParam( prevBuf, se_use_default );
-
-	if( *pCur == '^' )
-	{
-		skipChar( &pCur );
-		getSuperscript( prevBuf, true );
-
-		which = ci_msubsup;
-	}
-	else if( *pCur == char_prime )
-	{		
-		onPrime( prevBuf );
-		which = ci_msubsup;
-	}
-	else
-	{
-		which = ci_msub;
-	}
-}
-
-static void onSubscript( Buffer &prevBuf )
-{
-	Buffer str;
-	int index;
-	command_id which;
-	SymbolTable *sub;
-
-	index = getLastTagIndex( prevBuf.data(), prevBuf.length(), et_tag_on_open );
-
-	if( index < 0 )
-	{
-		throw error( pCur, ex_missing_subsup_base );
-	}	
-
-    str.setlength( 50 );
-
-	getSubscript( str, which );
-
-	if( which == ci_msub )
-	{
-		sub = &nolimits[0];		
-	}
-	else
-	{
-		sub = &nolimits[2];
-	}
-
-	prevBuf.insertAt( index, sub->tagOn );		
-	str.write( sub->tagOff );		
-
-	prevBuf.append( str, true );
-}
-
-
-
-enum limits_type { lt_default, lt_subsup, lt_underover };
-
-static void onLimits( Buffer &prevBuf, math_type mathType )
-{
-	limits_type useLimits;
-
-	useLimits = lt_default;
-
-	do {
-		if( followedBy( &pCur, "\\limits", sp_skip_all ) )
-		{
-			useLimits = lt_underover;
-		}
-		else if( followedBy( &pCur, "\\nolimits", sp_skip_all ) )
-		{
-			useLimits = lt_subsup;
-		}
-		else
-		{
-			break;
-		}
-	} while( 1 );
-
-	if( *pCur == char_null )
-	{
-		return;
-	}
-	else if( scriptNext( pCur ) || *pCur == char_prime )
-	{
-		Buffer str;
-		command_id which;
-		//char *nextChar;
-		int index;
-		SymbolTable *lim;
-
-		index = getLastTagIndex( prevBuf.data(), prevBuf.length(), et_tag_on_open );
-
-		if( index < 0 )
-		{
-			index = 0;
-		}
-
-
-		if( *pCur == '_' )
-		{		
-			skipChar( &pCur );
-			getSubscript( str, which );
-		}
-		else if( *pCur == '^' )
-		{
-			skipChar( &pCur );
-			getSuperscript( str, false );
-			which = ci_msup;		
-		}		
-		else // prime/////
-		{
-			onPrime( str );
-			which = ci_msup;			
-			
-			if( *pCur == '^' || *pCur == char_prime )
-			{
-				throw error( pCur, ex_double_superscript );
-			}
-			else if( *pCur == '_' )
-			{
-				throw error( pCur, ex_use_subscript_before_superscript );
-			}
-		}
-
-		if( useLimits == lt_underover )
-		{
-			lim = limits;
-		}
-		else if( useLimits == lt_subsup )
-		{
-			lim = nolimits;
-		}
-		else
-		{
-			if( mathType == mt_limits )
-			{
-				lim = nolimits;
-			}
-			else
-			{
-				lim = limitsMovable;
-			}
-		}
-
-		switch( which )
-		{
-		case ci_msub:
-			prevBuf.insertAt( index, lim[0].tagOn );
-			str.write( lim[0].tagOff );
-			break;
-		case ci_msup:
-			prevBuf.insertAt( index, lim[1].tagOn );
-			str.write( lim[1].tagOff );
-			break;
-		case ci_msubsup:				
-			prevBuf.insertAt( index, lim[2].tagOn );
-			str.write( lim[2].tagOff );
-			break;
-		}
-		prevBuf.append( str, true );		
-	}	
-}
-
-static void onEntity( Buffer &prevBuf, EntityStruct *entity, bool checkLimits, bool checkSubSup )
-{
-	
-	switch( entity->mathType )
-	{
-	case mt_ident:
-		prevBuf.format( "<mi>&#x%x;</mi>", entity->code );
-		break;
-	case mt_digit:
-		prevBuf.format( "<mn>&#x%x;</mn>", entity->code );
-		break;
-	case mt_ord:	
-	case mt_punct:
-		prevBuf.format( "<mo>&#x%x;</mo>", entity->code );
-		break;
-	case mt_limits:
-	case mt_mov_limits:
-		
-		prevBuf.format( "<mo>&#x%x;</mo>", entity->code );
-
-		if( checkLimits )
-		{
-			onLimits( prevBuf, entity->mathType );
-		}
-		break;
-	case mt_left_fence:
-	case mt_right_fence:
-	case mt_fence:
-		if( checkSubSup && scriptNext( pCur ) )
-		{
-			throw error( pCur, ex_ambiguous_script );
-		}
-		prevBuf.format( "<mo mathsize='1'>&#x%x;</mo>", entity->code );
-		break;
-	case mt_text:
-		prevBuf.format( "<mtext>&#x%x;</mtext>", entity->code );
-		break;
-	case mt_rel:
-	case mt_bin:
-	case mt_unary:
-	case mt_bin_unary:
-		prevBuf.format( "<mo>&#x%x;</mo>", entity->code );
-		break;
-	default:
-		throw error( pCur, ex_unhandled_mathtype );
-	}
-}
-
-static void onFunction( Buffer &prevBuf, FunctionStruct *function, bool checkLimits  )
-{
-	prevBuf.format( "<mi>%s</mi>", function->output );
-
-	if( ( function->mathType == mt_func_limits ) && checkLimits )
-	{
-		onLimits( prevBuf, function->mathType );
-	}	
-}
-/*
-enum param_type { pt_unknown, pt_none, pt_one, pt_two, pt_three, pt_table, pt_others,
-				  pt_especial };
-*/
-
-static void onSqrt( Buffer &prevBuf, const char *tagOn, const char *tagOff )
-{
-	
-	if( *pCur == char_prime )			
-	{
-		throw error( pCur, ex_missing_lbrace );
-	}
-	else if( *pCur == '[' )
-	{
-		Buffer str, radix;
-
-		skipChar( &pCur );
-		runLoop( radix, se_optional_param );
-		if( radix.length() != 0 )
-		{
-			str.write( "<mroot>" );
-			getCommandParam( str, se_use_default );
-			if( needsMrow( radix.data() ) )
-			{
-				radix.insertAt( 0, "<mrow>" );
-				radix.write( "</mrow>" );
-			}
-			str.append( radix, true );
-			str.write( "</mroot>" );
-		}
-		else
-		{
-			prevBuf.write( tagOn );
-			getCommandParam( str, se_use_default );
-			str.write( tagOff );
-		}
-
-		prevBuf.append( str, true );
-	}
-	else
-	{
-		prevBuf.write( tagOn );
-		getCommandParam( prevBuf, se_use_default );
-		prevBuf.write( tagOff );
-	}
-}
-
-static void getAttribute( Buffer &prevBuf, char lastChar )
-{
-	char *start, *end;
-	
-	start = pCur;
-
-	while( *pCur && ( *pCur != lastChar ) )
-	{
-		++pCur;
-	}
-
-	if( *pCur != lastChar )
-	{
-		throw error( pCur, ex_missing_end_tag );
-	}
-	
-	end = pCur - 1;
-
-
-	while( isspace( *end ) )
-	{
-		--end;
-	}
-
-	if( *end == char_backslash )
-	{
-		end += 2;
-	}
-	else
-	{
-		end++;
-	}
-
-	prevBuf.write( start, (end - start ) );
-
-	skipChar( &pCur );
-
-}
-
-static void onMiMnMo( Buffer &prevBuf, const char *tagOn, const char *tagOff )
-{
-	Buffer str;
-	const char* attrib;
-	char *start;
-
-	if( *pCur == '[' )
-	{
-		start = pCur+1;
-		skipChar( &pCur );
-		getAttribute( str, ']' );
-
-		attrib = getMathVariant( str.data() );
-
-		if( attrib == NULL )
-		{
-			throw error( start, ex_unknown_attribute );
-		}
-
-		str.destroy();
-		str.write( tagOn, strlen(tagOn) - 1 ); // don't include '>'
-		str.format( " mathvariant='%s'>", attrib );		
-	}	
-	else
-	{
-		str.write( tagOn );		
-	}
-	onMathFont( prevBuf, str.data(), tagOff );
-	//prevBuf.write( tagOff );			
-}
-
-
-static EnvironmentStruct *getEnvironmentType()
-{
-	Buffer str;
-	char *curPos;
-	EnvironmentStruct *environment;
-
-	if( *pCur != '{' )
-	{
-		throw error( pCur, ex_missing_lbrace );
-	}
-
-	skipChar( &pCur);
-
-	curPos = pCur;
-
-	getAttribute( str, '}' );
-
-	environment = getEnvironmentType( str.data() );
-
-	if( environment != NULL )
-	{
-		return environment;
-	}	
-	else
-	{
-		throw error( curPos, ex_undefined_environment_type );
-	}
-}
-
-static void getColumnAlignment( Buffer &align, short &maxColumn, const char *tagOn )
-{
-	char *curPos, *p, *attrib;
-	Buffer str;	
-
-	if( *pCur != '{' )
-	{
-		throw error( pCur, ex_missing_lbrace );
-	}
-
-	skipChar( &pCur );
-
-	curPos = pCur;
-
-	getAttribute( str, '}' );
-
-	if( str.length() == 0 )
-	{
-		throw error( pCur, ex_missing_column_alignment );
-	}
-
-	p = str.data();
-
-	maxColumn = 0;
-
-	attrib = (char *)strchr( tagOn, '>' );
-
-	align.write( tagOn, size_t( attrib - tagOn ) );
-	
-	align.write( " columnalign='" );
-
-	while( *p )
-	{
-		switch( *p )
-		{
-		case 'l':
-			align.write( "left" );			
-			break;
-		case 'c':
-			align.write( "center" );			
-			break;
-		case 'r':
-			align.write( "right" );			
-			break;
-		default:
-			if( isspace( *p ) )
-			{
-				++p;
-				continue;
-			}
-			throw error( curPos, 	ex_unknown_alignment_character );
-		}
-
-		++maxColumn;
-		++p;
-		if( *p )
-		{
-			align.write( " " );
-		}
-	}
-	align.format( "'%s", attrib );
-}
-
-static void onBeginEnvironment( Buffer &prevBuf  )
-{
-	ArrayStruct ar;
-	Buffer str, align;
-	EnvironmentStruct *environment;
-
-	environment = getEnvironmentType();
-
-	ar.id		   = environment->id;	
-	ar.columnCount = 1;
-	ar.maxColumn   = 5000; // arbitrary	
-
-	
-
-	switch( environment->id )
-	{
-	case ci_array:
-		getColumnAlignment( align, ar.maxColumn, environment->tagOn );
-		prevBuf.append( align, true );
-		runLoop( str, se_matrix, &ar );		
-		break;
-	case ci_eqnarray:
-		ar.maxColumn = 3; 
-		// fall through
-	default:		
-		prevBuf.write( environment->tagOn );
-		runLoop( str, se_matrix, &ar );
-		break;
-	}
-	str.write( environment->tagOff );
-	prevBuf.append( str, true );
-}
-
-static bool onEndEnvironment( sub_expression subType, void *paramExtra )
-{
-	command_id id;
-	char *temp;	
-	EnvironmentStruct *environment;
-
-	temp = pCur;
-	if( subType == se_matrix )
-	{
-		id = ((ArrayStruct *)paramExtra)->id;
-	}
-	else
-	{
-		throw error( temp, ex_missing_begin );		
-	}
-
-	environment = getEnvironmentType();
-
-	if( environment->id != id )
-	{
-		throw error( temp, ex_mismatched_environment_type );
-	}
-	return true;			
-}
-
-static void onColumn( Buffer &prevBuf, const char *pos, ArrayStruct &ar )
-{
-	++ar.columnCount;
-
-	if( ar.columnCount > ar.maxColumn )
-	{
-		throw error( pos, ex_too_many_columns );
-	}
-
-	prevBuf.write( "</mtd><mtd>" );
-}
-
-static void onRow( Buffer &prevBuf, ArrayStruct &ar )
-{
-	if( (*pCur == char_backslash ) && (pCur[1] == 'e' ) ) // \end?
-	{
-		if( followedBy( &pCur, "\\end", sp_no_skip ) )
-		{
-			return; // do nothing
-		}
-	}
-
-	prevBuf.write( "</mtd></mtr><mtr><mtd>" );
-	ar.columnCount = 1; // reset columns
-}
-
-
-static void onHfill( Buffer &prevBuf, sub_expression subType, void *paramExtra )
-{
-	if( scriptNext( pCur ) )
-	{
-		if( *pCur == '^' )
-		{
-			throw error( pCur, ex_prefix_superscript );
-		}
-		else
-		{
-			throw error( pCur, ex_prefix_subscript );
-		}
-	}
-	if( subType < se_matrix ) // not in a table
-	{
-		return;
-	}
-}
-
-static void onArrows( Buffer &prevBuf, const char *tagOn, const char *tagOff )
-{
-	Buffer str;
-
-	//tagOn is the base
-	if( *pCur == '[' )
-	{
-		Buffer underscript;
-
-		skipChar( &pCur );
-		runLoop( underscript, se_optional_param );
-		if( underscript.length() != 0 )
-		{
-			if( needsMrow( underscript.data() ) )
-			{
-				underscript.insertAt( 0, "<mrow>" );
-				underscript.write( "</mrow>" );
-			}
-			str.format( "<munderover>%s", tagOn );		
-
-			str.append( underscript, true );
-
-			getCommandParam( str, se_use_default );			
-			
-			str.write( "</munderover>" );
-			prevBuf.append( str, true );
-			return;
-		}
-	}
-
-	// fall through
-	//prevBuf.write( tagOn );
-	str.format( "<mover>%s", tagOn );		
-	getCommandParam( str, se_use_default );
-	str.write( tagOff );
-	prevBuf.append( str, true );
-}
-
-static void onCfrac( Buffer &prevBuf, const char *tagOn, const char *tagOff )
-{
-	Buffer str;
-	const char *extra = "<mstyle displaystyle='true' scriptlevel='0'>";
-
-	str.format( "%s%s", tagOn, extra );
-	getCommandParam( str, se_use_default );
-	str.format( "</mstyle>%s", extra );
-	getCommandParam( str, se_use_default );
-	str.write( tagOff );			
-	prevBuf.append( str, true );
-}
-
-
-static bool onCommand( Buffer &prevBuf, ControlStruct &control, sub_expression subType, void *paramExtra )
-{
-	Buffer str, str2;
-	CommandStruct *command;
-
-	command = control.command;
-
-	switch( command->param )
-	{
-	case pt_plain:
-		switch( command->id )
-		{
-		case ci_mn:
-		case ci_mo:			
-			onMiMnMo( prevBuf, command->tagOn, command->tagOff );			
-			break;
-		case ci_mathop:
-			onMathFont( str, command->tagOn, command->tagOff );
-			//str.write( command->tagOff );	
-			onLimits(str, mt_limits );
-			prevBuf.append( str, true );
-			break;
-		/*
-		case ci_mathrm:
-		case ci_mathit:
-		case ci_mathbf:
-		case ci_mathbi:
-		
-		case ci_mathord,
-		case ci_func:		
-		*/
-		case ci_mathfont:
-		case ci_mathord:
-		case ci_mathbin:
-		case ci_mathrel:
-			//str.write( command->tagOn );
-			onMathFont( str, command->tagOn, command->tagOff );
-			//str.write( command->tagOff );	
-			prevBuf.append( str, true );
-		}
-		break;
-	case pt_especial:
-		switch( command->id )
-		{
-		//case ci_mi:
-		
-		case ci_sqrt:
-			onSqrt( prevBuf, command->tagOn, command->tagOff );			
-			break;
-		case ci_begin:
-				onBeginEnvironment( prevBuf );
-				break;
-		case ci_end:
-			    return onEndEnvironment( subType, paramExtra );
-		case ci_stackrel:
-			str.write( command->tagOn );
-			getCommandParam( str2, se_use_default );
-			getCommandParam( str, se_use_default );
-			str.append( str2, true );
-			str.write( command->tagOff );
-			prevBuf.append( str, true );
-			break;
-		case ci_hfill:
-			onHfill( prevBuf, subType, paramExtra );
-			break;
-		case ci_strut:
-			prevBuf.write( command->tagOn );
-			break;
-		case ci_limits:
-		case ci_nolimits:
-			throw error( control.start, ex_misplaced_limits );			
-		case ci_mathstring:
-			onTextFont( prevBuf, command->tagOn, command->tagOff, command->id, false );			
-			break;
-		case ci_text:
-			onTextFont( prevBuf, command->tagOn, command->tagOff, command->id );
-			break;
-		case ci_eqno:
-		case ci_leqno:
-			if( subType != se_use_default )
-			{
-				throw error( pCur, ex_misplaced_eqno );
-			}
-			else if ( isNumberedFormula )
-			{
-				throw error( pCur, ex_duplicate_eqno );
-			}
-			isNumberedFormula = true;
-			onTextFont( eqNumber, command->tagOn, command->tagOff, ci_eqno, false );
-			break;
-		case ci_left:
-		case ci_right:
-			return onFence( prevBuf, command->id, subType, command->tagOn, command->tagOff );
-		case ci_ext_arrows:
-			onArrows( prevBuf, command->tagOn, command->tagOff );
-			break;
-		case ci_cfrac:
-			onCfrac( prevBuf, command->tagOn, command->tagOff );
-			break;			
-		case ci_underoverbrace:
-			str.write( command->tagOn );		
-			getCommandParam( str, se_use_default );
-			str.write( command->tagOff );					
-			onLimits( str, mt_mov_limits );
-			prevBuf.append( str, true );
-			break;
-		case ci_lsub:		
-			str.write( command->tagOn );		
-			getCommandParam( str, se_use_default );
-			str.write( "<mprescripts/>" );
-			getCommandParam( str, se_use_default );
-			str.write( "<none/>" );
-			str.write( command->tagOff );
-			prevBuf.append( str, true );
-			break;
-		case ci_lsup:
-			str.write( command->tagOn );		
-			getCommandParam( str, se_use_default );
-			str.write( "<mprescripts/><none/>" );
-			getCommandParam( str, se_use_default );			
-			str.write( command->tagOff );
-			prevBuf.append( str, true );
-			break;
-		case ci_lsubsup:		
-			str.write( command->tagOn );		
-			getCommandParam( str, se_use_default );
-			str.write( "<mprescripts/>" );
-			getCommandParam( str, se_use_default );
-			getCommandParam( str, se_use_default );
-			str.write( command->tagOff );
-			prevBuf.append( str, true );
-			break;
-		default:
-			break;
-		}
-		break;
-
-	case pt_one:		
-		prevBuf.write( command->tagOn );		
-		getCommandParam( prevBuf, se_use_default );
-		prevBuf.write( command->tagOff );		
-		break;
-
-	case pt_two:
-		prevBuf.write( command->tagOn );
-		getCommandParam( prevBuf, se_use_default );
-		getCommandParam( prevBuf, se_use_default );
-		prevBuf.write( command->tagOff );
-		break;
-
-	case pt_three:
-		break;
-
-	case pt_table:
-		break;
-
-	case pt_none:
-		break;
-
-	case pt_others:
-	default:
-		break;
-	}
-
-	return false; 
-}
-
-static void onMathFont( Buffer &prevBuf, const char *tagOn, const char *tagOff )
-{
-	InputStream input;
-	ControlStruct control;
-	SymbolStruct *symbol;
-	Buffer str;
-	int brace;
-	bool quitLoop;	
-
-	brace = 0;
-	
-	if( *pCur == '{' )
-	{
-		quitLoop  = false;	// loop
-	}
-	else
-	{
-		quitLoop = true;	// read only one char
-	}
-	
-
-	while( getInput( input, sp_skip_all ) )
-	{
-		switch( input.token )
-		{
-		case token_alpha:
-		case token_digit:
-			str.write( pCur, 1 );
-			++pCur;
-			break;
-		case token_prime:
-			{
-				SymbolStruct *sym;
-				char buf[5];
-
-				getPrime( &pCur, buf );
-
-				sym = getSymbol( buf );
-				str.write( sym->literal );
-			}
-			break;
-		case token_symbol:
-		case token_control_symbol:
-		case token_right_sq_bracket:			
-			symbol = getSymbol( input.buffer );
-			str.write( symbol->literal );
-			break;		
-		
-		case token_white_space:
-			str.write( "&#x00A0;" );			
-			if( isspace( *pCur ) )
-			{
-				skipSpaces( &pCur );
-			}
-			break;
-		case token_left_brace:
-			++brace;
-			break;
-		case token_right_brace:
-			--brace;
-			if( brace < 0 )
-			{
-				throw error( input.start, ex_missing_parameter );		
-			}			
-			quitLoop = true;
-			break;
-		case token_inline_math:
-			throw error( input.start, ex_misplaced_inline_formula );
-
-		case token_superscript:
-		case token_subscript:
-			throw error( input.start, ex_no_command_allowed );
-		case token_column_sep:
-			throw error( input.start, ex_misplaced_column_separator );
-		case token_row_sep:		
-			throw error( input.start, ex_misplaced_row_separator );		
-		
-		case token_control_name:
-			
-			switch( getControlTypeEx( input, control ) )
-			{		
-			case token_control_entity:
-				str.format( "&#x%x;", control.entity->code );
-				break;
-			case token_control_function:
-				str.write( control.function->output );				
-				break;				
-			case token_control_command:
-				throw error( input.start, ex_no_command_allowed );
-				break;
-			//case token_unknown:
-			default:
-				throw error( input.start, ex_undefined_control_sequence );								
-			}
-			break;
-		default:
-			break;
-		}
-		if( quitLoop )
-		{
-			break;
-		}
-	}
-
-	prevBuf.write( tagOn );
-	str.write( tagOff );
-	prevBuf.append( str, true );	
-}
-
-
-static void onTextFont( Buffer &prevBuf, const char *tagOn, const char *tagOff, command_id id, bool allowInline )
-{
-	InputStream input;
-	ControlStruct control;
-	SymbolStruct *symbol;
-	Buffer str, temp;
-	int brace;
-	bool quitLoop;
-
-	brace = 0;	
-
-	if( ( id != ci_eqno ) && ( id != ci_leqno ) )
-	{
-		if( *pCur != '{' )
-		{
-			throw error( pCur, ex_missing_lbrace );
-		}
-	}
-
-	quitLoop	   = false;		
-	
-	while( getInput( input, sp_skip_once ) )
-	{
-		switch( input.token )
-		{
-		case token_alpha:
-		case token_digit:
-			str.write( pCur, 1 );
-			++pCur;
-			break;
-		
-		case token_symbol:
-		case token_control_symbol:
-		case token_right_sq_bracket:
-			symbol = getSymbol( input.buffer );
-			str.write( symbol->literal );
-			break;
-		case token_prime:
-			if( pCur[1] == char_prime )
-			{
-				str.write( "&#x201D;" );
-				pCur += 2;
-			}
-			else
-			{
-				str.write( "&#x2019;" );
-				++pCur;
-			}			
-			break;
-		case token_inline_math:
-			if( !allowInline )
-			{
-				throw error( input.start, ex_misplaced_inline_formula );
-			}
-			if( str.length() > 0 )
-			{
-				temp.write( tagOn );
-				str.write( tagOff );
-				temp.append( str, true );
-				str.reset();					
-			}
-
-			skipChar( &pCur );
-			runLoop( str, se_inline_math, NULL );
-				// skip end $
-			++pCur;
-
-			if( needsMrow( str.data() ) )
-			{
-				str.insertAt( 0, "<mrow>" );
-				str.write( "</mrow>" );
-			}
-			temp.append( str, true );
-			str.reset();
-			break;
-
-		case token_white_space:
-			str.write( "&#x00A0;" );			
-			if( isspace( *pCur ) )
-			{
-				skipSpaces( &pCur );
-			}
-			break;
-		case token_left_brace:
-			++brace;
-			break;
-		case token_right_brace:
-			--brace;
-			if( brace < 0 )
-			{
-				throw error( input.start, ex_missing_parameter );		
-			}			
-			quitLoop = true;
-			break;
-		case token_superscript:
-		case token_subscript:
-			throw error( input.start, ex_no_command_allowed );
-		case token_column_sep:
-			throw error( input.start, ex_misplaced_column_separator );
-		case token_row_sep:		
-			throw error( input.start, ex_misplaced_row_separator );		
-		
-		case token_control_name:
-			
-			switch( getControlTypeEx( input, control ) )
-			{		
-			case token_control_entity:
-				str.format( "&#x%x;", control.entity->code );
-				break;
-			case token_control_function:
-				throw error( input.start, ex_not_math_mode );
-			case token_control_command:
-				throw error( input.start, ex_no_command_allowed );
-			//case token_unknown:
-			default:
-				throw error( input.start, ex_undefined_control_sequence );								
-			}
-			break;
-		default:
-			break;
-		}
-		if( quitLoop )
-		{
-			break;
-		}
-	}
-
-				
-	if( str.length() )
-	{
-		temp.write( tagOn );
-		str.write( tagOff );
-	}
-	temp.append( str, true );
-
-	if( needsMrow( temp.data() ) )
-	{
-		temp.insertAt( 0, "<mrow>" );
-		temp.write( "</mrow>" );
-	}
-	prevBuf.append( temp, true );	
-}
-
-static void getFence( Buffer &prevBuf, const char *tagOn, command_id id )
-{
-	InputStream input;
-	FenceStruct fence;
-	size_t len;
-
-
-	len = strlen( tagOn );
-
-	getInput( input, sp_skip_all );
-
-	switch( input.token )
-	{
-	case token_control_symbol:	
-	case token_symbol:	
-	case token_control_name:
-		if( !getFenceType( input.buffer, fence ) )
-		{
-			throw error( input.start, ex_missing_fence_parameter );
-		}
-		
-		if ( id == ci_left )
-		{
-			if( *input.start == '(' )
-			{
-				prevBuf.write( tagOn, len );
-			}
-			else
-			{
-				prevBuf.write( tagOn, len - 1 ); // don't write >
-				prevBuf.format( " left='%s'", fence.output );
-			}
-		}
-		else
-		{
-			if( *input.start == ')' )
-			{
-				prevBuf.write( "><mrow>" );
-			}
-			else
-			{
-				prevBuf.format( " right='%s'><mrow>", fence.output );
-			}
-		}
-		break;
-	default:
-		throw error( input.start, ex_missing_fence_parameter );
-	}
-}
-
-static bool onFence( Buffer &prevBuf, command_id id, sub_expression subType, const char *tagOn, const char *tagOff )
-{
-	Buffer str, fence;
-
-	if( id == ci_right )
-	{
-		if( subType == se_fence )
-		{
-			return true;
-		}
-		throw error( pCur, ex_missing_left_fence );
-	}
-	
-	getFence( fence, tagOn, ci_left );
-	runLoop( str, se_fence, NULL );
-	getFence( fence, tagOn, ci_right );
-
-	str.write( tagOff );
-	prevBuf.append( fence, true );
-	prevBuf.append( str, true );
-	return false;
-}
-
+/*
+//  Copyright (c) 2020 Peter Frane Jr. All Rights Reserved.
+//
+//  Use of this source code is governed by the GPL v. 3.0 license that can be
+//  found in the LICENSE file.
+//
+//  This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+//  OF ANY KIND, either express or implied.
+//
+//  For inquiries, email the author at pfranejr AT hotmail.com
+*/
+
+#include "tex2mml.h"
+#include "classes.h"
+#include "tables.h"
+#include "exceptions.h"
+#include <algorithm>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && ( _M_IX86_FP >= 2 ) )
+#define HAVE_SSE2
+#include <emmintrin.h>
+#if defined( __GNUC__ ) || defined( _MSC_VER )
+#define HAVE_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+#endif
+
+
+enum sub_expression { se_none, se_use_default, se_braced, se_optional_param, se_inline_math, se_fence,					 
+					  se_matrix };//, se_eqalign, se_array, se_eqnarray  };
+
+
+enum skip_input { sp_skip_all, sp_skip_once, sp_no_skip };
+
+enum { MAX_CONTROL_NAME = 32, EXTRA_BUF = 8 };
+
+
+#define char_null	   '\0'
+#define char_backslash '\\'
+#define char_prime	   '\''
+
+// character classes for the lexer. A table instead of <ctype.h> so the
+// result doesn't depend on the locale: bytes above 0x7F are symbols
+
+enum char_class { cc_symbol, cc_alpha, cc_digit, cc_space, cc_column_sep, cc_left_brace, 
+				  cc_right_brace, cc_superscript, cc_subscript, cc_backslash, 
+				  cc_right_sq_bracket, cc_inline_math, cc_prime };
+
+struct CharClassTable {
+	unsigned char cls[256];
+};
+
+constexpr CharClassTable makeCharClasses()
+{
+	CharClassTable table = {};
+
+	for( int c = 'a'; c <= 'z'; ++c )
+	{
+		table.cls[c] = cc_alpha;
+		table.cls[c - 'a' + 'A'] = cc_alpha;
+	}
+
+	for( int c = '0'; c <= '9'; ++c )
+	{
+		table.cls[c] = cc_digit;
+	}
+
+	table.cls[' ']  = cc_space;
+	table.cls['\t'] = cc_space;
+	table.cls['\n'] = cc_space;
+	table.cls['\v'] = cc_space;
+	table.cls['\f'] = cc_space;
+	table.cls['\r'] = cc_space;
+
+	table.cls['&']  = cc_column_sep;
+	table.cls['{']  = cc_left_brace;
+	table.cls['}']  = cc_right_brace;
+	table.cls['^']  = cc_superscript;
+	table.cls['_']  = cc_subscript;
+	table.cls[char_backslash] = cc_backslash;
+	table.cls[']']  = cc_right_sq_bracket;
+	table.cls['$']  = cc_inline_math;
+	table.cls[char_prime] = cc_prime;
+
+	return table;
+}
+
+static constexpr CharClassTable charClasses = makeCharClasses();
+
+inline char_class charClass( char c )
+{
+	return (char_class) charClasses.cls[ (unsigned char) c ];
+}
+
+inline bool isAlpha( char c )
+{
+	return charClass( c ) == cc_alpha;
+}
+
+inline bool isDigit( char c )
+{
+	return charClass( c ) == cc_digit;
+}
+
+inline bool isAlnum( char c )
+{
+	return isAlpha( c ) || isDigit( c );
+}
+
+inline bool isSpace( char c )
+{
+	return charClass( c ) == cc_space;
+}
+
+// the <mi> of each letter and the <mn> of each digit: the token of one
+// character points into this table instead of being copied
+
+enum { TOKEN_SIZE = sizeof( "<mi>x</mi>" ) - 1 };
+
+struct TokenTable {
+	char text[256][TOKEN_SIZE + 1];
+};
+
+constexpr TokenTable makeTokens()
+{
+	TokenTable table = {};
+
+	for( int c = 0; c < 256; ++c )
+	{
+		if( ( charClasses.cls[c] == cc_alpha ) || ( charClasses.cls[c] == cc_digit ) )
+		{
+			const char *tag = ( charClasses.cls[c] == cc_alpha ) ? "mi" : "mn";
+			char *p = table.text[c];
+
+			p[0] = '<';  p[1] = tag[0]; p[2] = tag[1]; p[3] = '>';
+			p[4] = (char) c;
+			p[5] = '<';  p[6] = '/'; p[7] = tag[0]; p[8] = tag[1]; p[9] = '>';
+		}
+	}
+
+	return table;
+}
+
+static constexpr TokenTable tokens = makeTokens();
+
+
+// a '{' and the '}' that closes it; close is NULL while the brace is open
+
+struct BracePair {
+	char *open, *close;
+};
+
+struct ArrayStruct {
+	short maxColumn, columnCount;
+	//sub_expression subType;
+	command_id id;
+	MathNode *table, *row;	// the table and the row being parsed
+	bool stream;		// its rows go to the output sink as they are done
+	ArenaMark rows;		// with 'stream': where the arena stood before the rows
+	const char *rowsStart;	// and where in the input the rows not yet sent begin
+};
+
+// a failed conversion records only where and why; getLastError() builds
+// the text when it's asked for
+
+struct ErrorMessage {
+	bool failed;
+	int code;
+	size_t index;
+	char name[MAX_CONTROL_NAME+EXTRA_BUF+1];	// of an undefined control sequence
+	const char *msg;	// NULL until built
+	string msg2;
+};
+
+struct InputStream {
+	token_type token;
+	char buffer[MAX_CONTROL_NAME+EXTRA_BUF+1];
+	char *start;
+	char nextChar;
+	const SymbolStruct *symbol;		// for symbols
+	const ControlName *control;		// for control names; NULL if unknown
+};
+
+
+static SymbolTable limits[] = {
+	{ "<munder>", "</munder>" },
+	{ "<mover>", "</mover>" },
+	{ "<munderover>", "</munderover>" }
+};
+
+static SymbolTable nolimits[] = {
+	{ "<msub>", "</msub>" },
+	{ "<msup>", "</msup>" },
+	{ "<msubsup>", "</msubsup>" }
+};
+
+static SymbolTable limitsMovable[] = {
+	{ "<msub movablelimits='true'>", "</msub>" },
+	{ "<msup movablelimits='true'>", "</msup>" },
+	{ "<msubsup movablelimits='true'>", "</msubsup>" }
+};
+
+// an error kept in recovery mode
+
+struct ErrorEntry {
+	int code;
+	size_t index;
+};
+
+struct ErrorList {
+	ErrorEntry *entries;		// in the arena
+	size_t count, size;
+};
+
+// one level of the parse stack. A group being parsed puts its elements
+// in 'node', which a braced group shares with the group around it:
+// {ab}^2. 'before' is the last element of the node when the group began,
+// so that a script at the start of the group finds no base. An error in
+// the token the group is on, or in a command that token began, takes
+// the row back to 'mark' and skips the input from 'start'.
+//
+// A command reading its arguments is a frame too: each argument in
+// braces is a group above it, and its 'step' is called when the group
+// is done. So nesting takes frames, never the thread's stack
+
+struct ParseFrame;
+
+typedef bool (*StepFunc)( ConverterContext &ctx, ParseFrame *frame );
+
+struct ParseFrame {
+	MathNode *node;			// a command: the row its element goes to
+	MathNode *before;
+	sub_expression subType;
+	void *paramExtra;
+	bool owned;				// the argument of a command, or the content of a \left or an environment
+	MathNode *mark;
+	size_t count;			// of the row at 'mark'
+	char *start;
+	StepFunc step;			// NULL in a group
+	int stage, params;		// the arguments read, and how many there are
+	command_id id;
+	const char *tagOn, *tagOff;
+	const SymbolTable *tags;	// scripts: their elements, by limits
+	MathNode *element;		// what the command builds; the base of scripts
+	MathNode *extra;		// a part kept aside: the scripts, a radix, a formula in text
+	char *close;			// text: the '}' it ends at
+	bool allowInline;
+	ArrayStruct array;		// an environment: its table
+};
+
+#define OUTPUT_UNMEASURED	((size_t) -1)
+
+// all the state of one conversion; a context may be reused for any
+// number of formulas but must not be shared by two threads at once
+
+struct ConverterContext {
+	char *pStart;
+	char *pCur;
+	char *pEnd;			// end of the input
+	bool isNumberedFormula;
+	// input checks: everything before pChecked has been checked
+	char *pChecked, *lastLeftBrace;
+	BracePair *bracePairs;		// every '{' checked, in input order
+	size_t *openBraces;			// indices of the pairs still open
+	size_t braceCount, braceSize, openCount;
+	bool checkFailed;			// the error came from the checks
+	Arena arena;		// the tree and every Buffer of a conversion allocate from here
+	// the brace pairs, the error lists and the parse stack: they outlive
+	// a streamed row, whose nodes are taken back from 'arena'
+	Arena listArena;
+	MathNode *root;				// the top-level row
+	MathNode *eqNumber;			// the label of \eqno
+	MathNode *output;			// the document; NULL if there is none
+	size_t outputLen;			// its length once measured, or OUTPUT_UNMEASURED
+	Buffer globalBuf;			// the document written out, for getMathMLOutput()
+	ErrorMessage errMsg;
+	// the parse stack: frames[0..depth) are the groups open now and the
+	// commands reading arguments in them, the ones above are kept for
+	// the next. All of them are in listArena
+	ParseFrame **frames;
+	size_t depth, frameCount, frameSize;
+	size_t groups;				// of the frames open
+	size_t maxDepth;			// groups that may be open inside one another
+	int style;					// output_style bits: setCompactOutput(), setOutputDialect()
+	// recovery mode goes on after an error; see convertFormula()
+	bool recover;
+	ErrorList checkErrors, parseErrors;
+	// streaming: the output goes to sink as it becomes final; see
+	// startStream(). streamBuf holds a chunk while it is sent
+	OutputSink sink;
+	void *sinkUser;
+	bool display, streamed, streamMrow, streamNext;
+	const char *eqnoFound, *eqnoScanned;	// see equationNumberFollows()
+	Buffer streamBuf;
+
+	ConverterContext( bool hugePages = false )
+		: arena( hugePages ), output( NULL ), globalBuf( &arena ), maxDepth( NESTING_LIMIT_DEFAULT ), style( 0 ), recover( false ), sink( NULL ) {}
+};
+
+// the input is [pStart, pEnd) and needn't be null-terminated: reads go
+// through here, which gives a null at the end (or at an embedded null)
+
+inline char peek( const ConverterContext &ctx, const char *p, size_t ahead = 0 )
+{
+	return ( ctx.pEnd - p > (ptrdiff_t) ahead ) ? p[ahead] : char_null;
+}
+
+// context used by the functions that don't take one; each thread
+// gets its own so that the old API is safe to call concurrently
+
+static thread_local ConverterContext defaultContext;
+
+static ConverterContext &getContext( ConverterContext *ctx )
+{
+	return ( ctx != NULL ) ? *ctx : defaultContext;
+}
+
+
+static void onDigit( ConverterContext &ctx, MathNode *row );
+static void onAlpha( ConverterContext &ctx, MathNode *row );
+static bool onSymbol( ConverterContext &ctx, MathNode *row, InputStream &input, bool checkSubSup = true );
+static bool onSubscript( ConverterContext &ctx, MathNode *base );
+static bool onSuperscript( ConverterContext &ctx, MathNode *base );
+static bool stepScripts( ConverterContext &ctx, ParseFrame *frame );
+static bool onEntity( ConverterContext &ctx, MathNode *row, const ControlStruct &control, bool checkLimits = true, bool checkSubSup = true );
+static bool onFunction( ConverterContext &ctx, MathNode *row, const ControlStruct &control, bool checkLimits = true );
+static bool onCommand( ConverterContext &ctx, MathNode *row, ControlStruct &control, sub_expression subType, void *paramExtra, bool &quit );
+static bool getCommandParam( ConverterContext &ctx, MathNode *dest, sub_expression subType );
+static bool followedBy( ConverterContext &ctx, char **p, const char *pattern, skip_input skip );
+bool parseExpression( ConverterContext &ctx, const char *input, size_t len, size_t *errorIndex, int *errCode, bool recover, OutputSink sink = NULL, void *user = NULL, bool display = false );
+static bool runLoop( ConverterContext &ctx, MathNode *node );
+static ParseFrame *pushGroup( ConverterContext &ctx, MathNode *node, sub_expression subType, void *paramExtra, bool owned );
+static ParseFrame *pushCommand( ConverterContext &ctx, StepFunc step, MathNode *row );
+static ParseFrame *popFrame( ConverterContext &ctx );
+static const EnvironmentStruct *getEnvironmentType( ConverterContext &ctx );
+static bool onBeginEnvironment( ConverterContext &ctx, MathNode *row );
+static bool stepSqrt( ConverterContext &ctx, ParseFrame *frame );
+static bool stepArrows( ConverterContext &ctx, ParseFrame *frame );
+static bool stepCommand( ConverterContext &ctx, ParseFrame *frame );
+static bool onEndEnvironment( ConverterContext &ctx, sub_expression subType, void *paramExtra );
+static bool startChecks( ConverterContext &ctx );
+static bool finishChecks( ConverterContext &ctx );
+static void keepError( ConverterContext &ctx );
+static bool matchBrace( ConverterContext &ctx, const char *p, char **close );
+static char *getClosingBrace( ConverterContext &ctx );
+static void skipSpaces( ConverterContext &ctx, char **p );
+static void skipChar( ConverterContext &ctx, char **p );
+static bool getInput( ConverterContext &ctx, InputStream &input, skip_input white_space );
+static bool scriptNext( ConverterContext &ctx, char *p );
+static token_type getControlTypeEx( ConverterContext &ctx, InputStream &input, ControlStruct &control );
+static bool onColumn( ConverterContext &ctx, ParseFrame *frame, const char *pos, ArrayStruct &ar );
+static void onRow( ConverterContext &ctx, ParseFrame *frame, ArrayStruct &ar );
+static bool onMathFont( ConverterContext &ctx, MathNode *row, const char *tagOn, const char *tagOff, command_id id );
+static size_t characterCount( const char *s, size_t len );
+static bool onTextFont( ConverterContext &ctx, MathNode *dest, const char *tagOn, const char *tagOff, command_id id, bool allowInline = true );
+static bool stepText( ConverterContext &ctx, ParseFrame *frame );
+static bool onFence( ConverterContext &ctx, MathNode *row, command_id id, sub_expression subType, const char *tagOn, const char *tagOff, bool &quit );
+static bool stepFence( ConverterContext &ctx, ParseFrame *frame );
+static bool onEndExpression( ConverterContext &ctx, sub_expression subType, token_type token, const CommandStruct *command );
+static void getPrime( ConverterContext &ctx, char **p, char *buf );
+static void getControlName( ConverterContext &ctx, const char *start, char *name );
+static void onPrime( ConverterContext &ctx, MathNode *row );
+static bool equationNumberFollows( ConverterContext &ctx, const char *p );
+static const char *environmentEnd( ConverterContext &ctx, const char *p );
+static void startStream( ConverterContext &ctx, ParseFrame *top );
+static void streamRows( ConverterContext &ctx, ParseFrame *frame, ArrayStruct &ar );
+static void finishStream( ConverterContext &ctx );
+static size_t outputLength( ConverterContext &ctx );
+
+static const char mathOn[] = "<math>";
+static const char mathDisplayOn[] = "<math display='block'>";
+static const char mathOff[] = "</math>";
+static const char miNormal[] = "<mi mathvariant='normal'>";	// \mathrm
+
+ConverterContext *createConverter( bool hugePages )
+{
+	return new ConverterContext( hugePages );
+}
+
+void destroyConverter( ConverterContext *ctx )
+{
+	delete ctx;
+}
+
+void setNestingLimit( ConverterContext *ctx, size_t limit )
+{
+	getContext( ctx ).maxDepth = limit;
+}
+
+void setCompactOutput( ConverterContext *ctx, bool compact )
+{
+	ConverterContext &context = getContext( ctx );
+
+	context.style = compact ? ( context.style | STYLE_COMPACT ) : ( context.style & ~STYLE_COMPACT );
+}
+
+void setOutputDialect( ConverterContext *ctx, output_dialect dialect )
+{
+	ConverterContext &context = getContext( ctx );
+
+	context.style = ( dialect == dialect_mathml_core ) ? ( context.style | STYLE_CORE ) : ( context.style & ~STYLE_CORE );
+}
+
+bool convertFormula( ConverterContext *ctx, const char *input, size_t len, size_t *errorIndex, int *errCode )
+{
+	
+	if( len == INPUT_NUL_TERMINATED )
+	{
+		len = strlen( input );
+	}
+
+	if( len == 0 )
+	{
+		return false;
+	}
+
+	return parseExpression( getContext( ctx ), input, len, errorIndex, errCode, false );	
+}
+
+static bool errorBefore( const FormulaError &a, const FormulaError &b )
+{
+	return a.pos < b.pos;
+}
+
+bool convertFormula( ConverterContext *ctx, const char *input, size_t len, vector<FormulaError> &errors )
+{
+	ConverterContext &context = getContext( ctx );
+	ErrorList *lists[] = { &context.checkErrors, &context.parseErrors };
+	FormulaError entry;
+	char name[MAX_CONTROL_NAME+EXTRA_BUF+1];
+	size_t errorIndex, i, j, count;
+	int errCode;
+
+	errors.clear();
+
+	if( len == INPUT_NUL_TERMINATED )
+	{
+		len = strlen( input );
+	}
+
+	if( len == 0 )
+	{
+		return false;
+	}
+
+	if( parseExpression( context, input, len, &errorIndex, &errCode, true ) )
+	{
+		return true;
+	}
+
+	// the check errors go first, so that they stay first at the same offset
+
+	for( i = 0; i < 2; ++i )
+	{
+		for( j = 0; j < lists[i]->count; ++j )
+		{
+			entry.code = lists[i]->entries[j].code;
+			entry.pos  = lists[i]->entries[j].index;
+			entry.msg  = getErrorMsg( (ex_exception) entry.code );
+
+			if( entry.code == ex_undefined_control_sequence )
+			{
+				getControlName( context, context.pStart + entry.pos, name );
+				entry.msg.append( ": " );
+				entry.msg.append( name );
+			}
+			errors.push_back( entry );
+		}
+	}
+
+	stable_sort( errors.begin(), errors.end(), errorBefore );
+
+	// one error per offset
+
+	count = 1;
+
+	for( i = 1; i < errors.size(); ++i )
+	{
+		if( errors[i].pos != errors[count-1].pos )
+		{
+			errors[count++] = errors[i];
+		}
+	}
+	errors.resize( count );
+
+	return false;
+}
+
+bool convertFormula( ConverterContext *ctx, const char *input, size_t len, bool display, OutputSink sink, void *user, size_t *errorIndex, int *errCode )
+{
+	if( len == INPUT_NUL_TERMINATED )
+	{
+		len = strlen( input );
+	}
+
+	if( len == 0 )
+	{
+		return false;
+	}
+
+	return parseExpression( getContext( ctx ), input, len, errorIndex, errCode, false, sink, user, display );
+}
+
+bool convertFormula(const char *input, size_t len, size_t *errorIndex, int *errCode )
+{
+	return convertFormula( NULL, input, len, errorIndex, errCode );
+}
+
+// in recovery mode: makes the error at the lowest offset the last error,
+// a check error before a parse error at the same offset; false if none
+
+static bool firstError( ConverterContext &ctx )
+{
+	ErrorList *lists[] = { &ctx.checkErrors, &ctx.parseErrors };
+	ErrorEntry *first = NULL;
+	size_t i, j;
+
+	for( i = 0; i < 2; ++i )
+	{
+		for( j = 0; j < lists[i]->count; ++j )
+		{
+			if( ( first == NULL ) || ( lists[i]->entries[j].index < first->index ) )
+			{
+				first = &lists[i]->entries[j];
+			}
+		}
+	}
+
+	if( first == NULL )
+	{
+		return false;
+	}
+
+	ctx.errMsg.failed = true;
+	ctx.errMsg.code   = first->code;
+	ctx.errMsg.index  = first->index;
+	ctx.errMsg.msg	  = NULL;
+
+	return true;
+}
+
+bool parseExpression( ConverterContext &ctx, const char *input, size_t len, size_t *errorIndex, int *errCode, bool recover, OutputSink sink, void *user, bool display )
+{
+	
+	bool result;
+
+	ctx.pStart	  = (char *)input;
+	ctx.pCur	  = ctx.pStart;
+	ctx.pEnd      = ctx.pStart + len;	
+
+	ctx.errMsg.failed = false;
+	ctx.errMsg.msg	  = NULL;
+
+	ctx.globalBuf.destroy();
+	ctx.arena.reset();
+	ctx.listArena.reset();
+	ctx.isNumberedFormula = false;
+	ctx.root	  = newNode( ctx.arena, nt_row );
+	ctx.eqNumber  = NULL;
+	ctx.output	  = NULL;
+	ctx.outputLen = OUTPUT_UNMEASURED;
+
+	ctx.frames	   = NULL;
+	ctx.depth	   = 0;
+	ctx.frameCount = 0;
+	ctx.frameSize  = 0;
+	ctx.groups	   = 0;
+
+	ctx.recover = recover;
+	ZeroMemory( &ctx.checkErrors, sizeof( ErrorList ) );
+	ZeroMemory( &ctx.parseErrors, sizeof( ErrorList ) );
+
+	ctx.sink	    = sink;
+	ctx.sinkUser	= user;
+	ctx.display	    = display;
+	ctx.streamed	= false;
+	ctx.streamMrow	= false;
+	ctx.streamNext	= false;
+	ctx.eqnoFound	= NULL;
+	ctx.eqnoScanned = ctx.pStart;
+
+	result = startChecks( ctx ) && runLoop( ctx, ctx.root ) && finishChecks( ctx );
+
+	// the top-level row is an <mrow> if it has more than one element;
+	// once streaming started that was decided and sent. The document is
+	// written when the output is asked for
+
+	ctx.output = ctx.root;
+
+	if( ctx.isNumberedFormula )
+	{
+		ctx.output = newNode( ctx.arena, nt_element );
+		ctx.output->textOff = "</mtd></mlabeledtr></mtable>";
+		ctx.output->lenOff	= sizeof( "</mtd></mlabeledtr></mtable>" ) - 1;
+
+		addChild( ctx.output, ctx.eqNumber );
+		addChild( ctx.output, ctx.root );
+	}
+
+	if( ctx.recover )
+	{
+		// the output stays unless the parse couldn't go on
+		if( !result )
+		{
+			keepError( ctx );
+			finishChecks( ctx );
+			ctx.output = NULL;
+		}
+		result = !firstError( ctx );
+	}
+
+	if( !result )
+	{
+		// an error the checks find anywhere in the input comes first;
+		// recovery mode has run them all
+		if( !ctx.recover && !ctx.checkFailed )
+		{
+			finishChecks( ctx );
+		}
+
+		if( ctx.checkFailed )
+		{
+			ctx.output = NULL;
+		}
+
+		// the name is taken now: the input may be gone when the message is built
+		if( ctx.errMsg.code == ex_undefined_control_sequence )
+		{
+			getControlName( ctx, ctx.pStart + ctx.errMsg.index, ctx.errMsg.name );
+		}
+
+		*errCode    = ctx.errMsg.code;
+		*errorIndex = ctx.errMsg.index;
+	}
+
+	// the output went to the sink
+	if( ctx.sink != NULL )
+	{
+		if( result )
+		{
+			finishStream( ctx );
+		}
+		ctx.output = NULL;
+		ctx.sink   = NULL;
+	}
+
+	return result;
+}
+
+
+// the length of the document without the <math> tags; 0 if there is
+// none. The tree is measured once per conversion
+
+static size_t outputLength( ConverterContext &ctx )
+{
+	if( ctx.output == NULL )
+	{
+		return 0;
+	}
+
+	if( ctx.outputLen == OUTPUT_UNMEASURED )
+	{
+		ctx.outputLen = treeLength( ctx.output );
+	}
+
+	return ctx.outputLen;
+}
+
+const char *getMathMLOutput( ConverterContext *ctx )
+{
+	ConverterContext &context = getContext( ctx );
+	size_t len;
+
+	len = outputLength( context );
+
+	if( len == 0 )
+	{
+		return NULL;
+	}
+
+	if( context.globalBuf.length() == 0 )
+	{
+		writeTree( context.output, context.globalBuf.extend( len ) );
+	}
+
+	return context.globalBuf.data();
+}
+
+const char *getMathMLOutput()
+{
+	return getMathMLOutput( NULL );
+}
+
+bool getMathMLOutput( ConverterContext *ctx, string& buf, bool display)
+{
+	size_t len;
+
+	len = getMathMLOutput( ctx, NULL, 0, display );
+
+	if( len != 0 )
+	{
+		buf.resize( len );
+		getMathMLOutput( ctx, &buf[0], len, display );
+
+		return true;
+	}
+	return false;
+}
+
+bool getMathMLOutput(string& buf, bool display)
+{
+	return getMathMLOutput( NULL, buf, display );
+}
+
+// the tree is written straight to 'buf'
+
+size_t getMathMLOutput( ConverterContext *ctx, char *buf, size_t size, bool display )
+{
+	ConverterContext &context = getContext( ctx );
+	const char *tagOn;
+	size_t len, onLen, textLen;
+
+	textLen = outputLength( context );
+
+	if( textLen == 0 )
+	{
+		return 0;
+	}
+
+	tagOn = display ? mathDisplayOn : mathOn;
+	onLen = display ? sizeof( mathDisplayOn ) - 1 : sizeof( mathOn ) - 1;
+	len   = onLen + textLen + sizeof( mathOff ) - 1;
+
+	if( size < len )
+	{
+		return len;
+	}
+
+	memcpy( buf, tagOn, onLen );
+	writeTree( context.output, buf + onLen );
+	memcpy( buf + len - ( sizeof( mathOff ) - 1 ), mathOff, sizeof( mathOff ) - 1 );
+
+	if( size > len )
+	{
+		buf[len] = char_null;
+	}
+
+	return len;
+}
+
+size_t getMathMLOutput( char *buf, size_t size, bool display )
+{
+	return getMathMLOutput( NULL, buf, size, display );
+}
+
+// the tree is written once, into the block handed over; the context
+// keeps nothing of it
+
+char *releaseMathMLOutput( ConverterContext *ctx, bool display, size_t *len )
+{
+	ConverterContext &context = getContext( ctx );
+	const char *tagOn;
+	size_t onLen, textLen, total;
+	char *p;
+
+	textLen = outputLength( context );
+
+	if( textLen == 0 )
+	{
+		return NULL;
+	}
+
+	tagOn = display ? mathDisplayOn : mathOn;
+	onLen = display ? sizeof( mathDisplayOn ) - 1 : sizeof( mathOn ) - 1;
+	total = onLen + textLen + sizeof( mathOff ) - 1;
+
+	p = (char *) malloc( total + 1 );
+
+	if( p == NULL )
+	{
+		throw ex_out_of_memory;
+	}
+
+	memcpy( p, tagOn, onLen );
+	writeTree( context.output, p + onLen );
+	memcpy( p + onLen + textLen, mathOff, sizeof( mathOff ) );
+
+	context.output = NULL;
+	context.globalBuf.destroy();
+
+	if( len != NULL )
+	{
+		*len = total;
+	}
+
+	return p;
+}
+
+char *releaseMathMLOutput( bool display, size_t *len )
+{
+	return releaseMathMLOutput( NULL, display, len );
+}
+
+// copies the control sequence at 'start' into 'name', which holds
+// MAX_CONTROL_NAME+EXTRA_BUF chars and the null
+
+static void getControlName(ConverterContext& ctx, const char* start, char *name)
+{
+	const char* p = start+1;
+	int i = 0;
+
+	name[i++] = '\\';
+
+	if (!isAlpha(peek(ctx, p)))
+	{
+		name[i++] = peek(ctx, p);
+	}
+	else
+	{
+		while (isAlnum(peek(ctx, p)) && (i < MAX_CONTROL_NAME+EXTRA_BUF))
+		{
+			name[i++] = *p;
+			++p;
+		}
+	}
+	name[i] = char_null;
+}
+
+// records the error and returns false, for the caller to return in turn:
+// return error( ctx, ctx.pCur, ex_missing_lbrace );
+
+bool error( ConverterContext &ctx, const char *index, ex_exception code )
+{
+	ctx.errMsg.failed = true;
+	ctx.errMsg.code   = (int) code;
+	ctx.errMsg.index  = (size_t) (index - ctx.pStart);	
+
+	return false;
+}
+
+
+const char *getLastError( ConverterContext *ctx )
+{
+	ErrorMessage &errMsg = getContext( ctx ).errMsg;
+
+	if( !errMsg.failed )
+	{
+		return NULL;
+	}
+
+	if( errMsg.msg == NULL )
+	{
+		if( errMsg.code == ex_undefined_control_sequence )
+		{
+			errMsg.msg2 = getErrorMsg( (ex_exception) errMsg.code );
+			errMsg.msg2.append( ": " );
+			errMsg.msg2.append( errMsg.name );
+
+			errMsg.msg = errMsg.msg2.c_str();
+		}
+		else
+		{
+			errMsg.msg = getErrorMsg( (ex_exception) errMsg.code );
+		}
+	}
+
+	return errMsg.msg;
+}
+
+const char *getLastError()
+{
+	return getLastError( NULL );
+}
+
+/*
+
+ SCANNING for the bytes the checks act on: { } \\ ^ _ & $ and null.
+ Everything between them is skipped a block at a time; no version
+ reads at or past end
+
+*/
+
+typedef const char *(*ScanFunc)( const char *s, const char *end );
+
+inline bool isScanStop( char c )
+{
+	switch( c )
+	{
+	case char_null:
+	case '{':
+	case '}':
+	case char_backslash:
+	case '^':
+	case '_':
+	case '&':
+	case '$':
+		return true;
+	}
+	return false;
+}
+
+static const char *scanScalar( const char *s, const char *end )
+{
+	while( ( s < end ) && !isScanStop( *s ) )
+	{
+		++s;
+	}
+	return s;
+}
+
+#ifdef HAVE_SSE2
+
+inline unsigned int firstBit( unsigned int mask )
+{
+#ifdef _MSC_VER
+	unsigned long index;
+
+	_BitScanForward( &index, mask );
+	return index;
+#else
+	return __builtin_ctz( mask );
+#endif
+}
+
+static const char *scanSSE2( const char *s, const char *end )
+{
+	const __m128i lbrace = _mm_set1_epi8( '{' ), rbrace = _mm_set1_epi8( '}' );
+	const __m128i backslash = _mm_set1_epi8( char_backslash ), caret = _mm_set1_epi8( '^' );
+	const __m128i underscore = _mm_set1_epi8( '_' ), amp = _mm_set1_epi8( '&' );
+	const __m128i dollar = _mm_set1_epi8( '$' ), zero = _mm_setzero_si128();
+	__m128i v, m;
+	unsigned int mask;
+
+	while( end - s >= 16 )
+	{
+		v = _mm_loadu_si128( (const __m128i *) s );
+		m = _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( v, lbrace ), _mm_cmpeq_epi8( v, rbrace ) ),
+						  _mm_or_si128( _mm_cmpeq_epi8( v, backslash ), _mm_cmpeq_epi8( v, caret ) ) );
+		m = _mm_or_si128( m, _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( v, underscore ), _mm_cmpeq_epi8( v, amp ) ),
+										   _mm_or_si128( _mm_cmpeq_epi8( v, dollar ), _mm_cmpeq_epi8( v, zero ) ) ) );
+		mask = (unsigned int) _mm_movemask_epi8( m );
+
+		if( mask != 0 )
+		{
+			return s + firstBit( mask );
+		}
+		s += 16;
+	}
+
+	return scanScalar( s, end );
+}
+
+#endif
+
+#ifdef HAVE_AVX2
+
+#ifdef __GNUC__
+__attribute__(( target( "avx2" ) ))
+#endif
+static const char *scanAVX2( const char *s, const char *end )
+{
+	const __m256i lbrace = _mm256_set1_epi8( '{' ), rbrace = _mm256_set1_epi8( '}' );
+	const __m256i backslash = _mm256_set1_epi8( char_backslash ), caret = _mm256_set1_epi8( '^' );
+	const __m256i underscore = _mm256_set1_epi8( '_' ), amp = _mm256_set1_epi8( '&' );
+	const __m256i dollar = _mm256_set1_epi8( '$' ), zero = _mm256_setzero_si256();
+	__m256i v, m;
+	unsigned int mask;
+
+	while( end - s >= 32 )
+	{
+		v = _mm256_loadu_si256( (const __m256i *) s );
+		m = _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8( v, lbrace ), _mm256_cmpeq_epi8( v, rbrace ) ),
+							 _mm256_or_si256( _mm256_cmpeq_epi8( v, backslash ), _mm256_cmpeq_epi8( v, caret ) ) );
+		m = _mm256_or_si256( m, _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8( v, underscore ), _mm256_cmpeq_epi8( v, amp ) ),
+												 _mm256_or_si256( _mm256_cmpeq_epi8( v, dollar ), _mm256_cmpeq_epi8( v, zero ) ) ) );
+		mask = (unsigned int) _mm256_movemask_epi8( m );
+
+		if( mask != 0 )
+		{
+			return s + firstBit( mask );
+		}
+		s += 32;
+	}
+
+	return scanSSE2( s, end );
+}
+
+static bool hasAVX2()
+{
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid( info, 0 );
+	if( info[0] < 7 )
+	{
+		return false;
+	}
+
+	__cpuid( info, 1 );
+	// OSXSAVE and AVX, and the OS saves the YMM registers
+	if( ( ( info[2] & ( 1 << 27 ) ) == 0 ) || ( ( info[2] & ( 1 << 28 ) ) == 0 ) || ( ( _xgetbv( 0 ) & 6 ) != 6 ) )
+	{
+		return false;
+	}
+
+	__cpuidex( info, 7, 0 );
+	return ( info[1] & ( 1 << 5 ) ) != 0;
+#else
+	// runs from a static initializer, which may come before the
+	// constructor that sets up the CPU data
+	__builtin_cpu_init();
+
+	return __builtin_cpu_supports( "avx2" ) != 0;
+#endif
+}
+
+#endif
+
+static ScanFunc selectScan()
+{
+#ifdef HAVE_AVX2
+	if( hasAVX2() )
+	{
+		return scanAVX2;
+	}
+#endif
+#ifdef HAVE_SSE2
+	return scanSSE2;
+#else
+	return scanScalar;
+#endif
+}
+
+// chosen once, for the CPU we run on
+static const ScanFunc scanBlocks = selectScan();
+
+// most runs are a few bytes long: those are cheaper to walk than to
+// hand to the vector code
+
+static const char *scanPlain( const char *s, const char *end )
+{
+	for( int i = 0; i < 4; ++i, ++s )
+	{
+		if( ( s >= end ) || isScanStop( *s ) )
+		{
+			return s;
+		}
+	}
+	return scanBlocks( s, end );
+}
+
+/*
+
+ CHECKS trap as many errors as possible. They used to run over the whole
+ input before the parse; now getInput runs them a little ahead of the
+ token it reads, so the input streams through once. Their errors still
+ win over any parse error, as if they had run first: parseExpression
+ finishes them before reporting one
+
+*/
+
+enum { CHECK_AHEAD = 512 };
+
+static void addError( ConverterContext &ctx, ErrorList &list, int code, size_t index )
+{
+	if( list.count == list.size )
+	{
+		if( list.size == 0 )
+		{
+			list.size    = 16;
+			list.entries = (ErrorEntry *) ctx.listArena.alloc( list.size * sizeof( ErrorEntry ) );
+		}
+		else
+		{
+			list.entries = (ErrorEntry *) ctx.listArena.resize( list.entries, list.size * sizeof( ErrorEntry ), 2 * list.size * sizeof( ErrorEntry ) );
+			list.size   *= 2;
+		}
+	}
+
+	list.entries[list.count].code  = code;
+	list.entries[list.count].index = index;
+	++list.count;
+}
+
+// in recovery mode a check error is only listed: the parse goes on
+
+static bool checkError( ConverterContext &ctx, const char *index, ex_exception code )
+{
+	if( ctx.recover )
+	{
+		ErrorList &list = ctx.checkErrors;
+		size_t pos = (size_t) (index - ctx.pStart);
+
+		if( ( list.count == 0 ) || ( list.entries[list.count-1].index != pos ) )
+		{
+			addError( ctx, list, (int) code, pos );
+		}
+		return true;
+	}
+
+	ctx.checkFailed = true;
+
+	return error( ctx, index, code );
+}
+
+// lists the parse error just recorded
+
+static void keepError( ConverterContext &ctx )
+{
+	addError( ctx, ctx.parseErrors, ctx.errMsg.code, ctx.errMsg.index );
+	ctx.errMsg.failed = false;
+}
+
+// true if the checks listed an error between start and end; they run
+// ahead of the parse, in the order of the input
+
+static bool checkErrorIn( ConverterContext &ctx, const char *start, const char *end )
+{
+	ErrorList &list = ctx.checkErrors;
+	size_t low, high, mid;
+
+	low  = 0;
+	high = list.count;
+
+	while( low < high )
+	{
+		mid = ( low + high ) / 2;
+
+		if( list.entries[mid].index < (size_t) (start - ctx.pStart) )
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	return ( low < list.count ) && ( list.entries[low].index <= (size_t) (end - ctx.pStart) );
+}
+
+static void openBrace( ConverterContext &ctx, char *s )
+{
+	if( ctx.braceCount == ctx.braceSize )
+	{
+		if( ctx.braceSize == 0 )
+		{
+			ctx.braceSize  = 64;
+			ctx.bracePairs = (BracePair *) ctx.listArena.alloc( ctx.braceSize * sizeof( BracePair ) );
+			ctx.openBraces = (size_t *) ctx.listArena.alloc( ctx.braceSize * sizeof( size_t ) );
+		}
+		else
+		{
+			ctx.bracePairs = (BracePair *) ctx.listArena.resize( ctx.bracePairs, ctx.braceSize * sizeof( BracePair ), 2 * ctx.braceSize * sizeof( BracePair ) );
+			ctx.openBraces = (size_t *) ctx.listArena.resize( ctx.openBraces, ctx.braceSize * sizeof( size_t ), 2 * ctx.braceSize * sizeof( size_t ) );
+			ctx.braceSize *= 2;
+		}
+	}
+
+	ctx.bracePairs[ctx.braceCount].open  = s;
+	ctx.bracePairs[ctx.braceCount].close = NULL;
+	ctx.openBraces[ctx.openCount++] = ctx.braceCount++;
+}
+
+static void closeBrace( ConverterContext &ctx, char *s )
+{
+	ctx.bracePairs[ ctx.openBraces[--ctx.openCount] ].close = s;
+}
+
+// drops the pairs closed before p: the parse is past them and looks up
+// only the '{' it is at. The open pairs stay, so the indices of the
+// ones in openBraces move down by the pairs dropped before them
+
+static void dropBraces( ConverterContext &ctx, const char *p )
+{
+	size_t kept, open, i;
+
+	kept = 0;
+	open = 0;
+
+	for( i = 0; i < ctx.braceCount; ++i )
+	{
+		BracePair &pair = ctx.bracePairs[i];
+
+		if( ( pair.close != NULL ) && ( pair.close < p ) )
+		{
+			continue;
+		}
+		if( ( open < ctx.openCount ) && ( ctx.openBraces[open] == i ) )
+		{
+			ctx.openBraces[open++] = kept;
+		}
+		ctx.bracePairs[kept++] = pair;
+	}
+
+	ctx.braceCount = kept;
+}
+
+static bool startChecks( ConverterContext &ctx )
+{
+	char *s;
+	bool ok;
+
+	ctx.bracePairs	  = NULL;
+	ctx.openBraces	  = NULL;
+	ctx.braceCount	  = 0;
+	ctx.braceSize	  = 0;
+	ctx.openCount	  = 0;
+	ctx.lastLeftBrace = NULL;
+	ctx.checkFailed	  = false;
+
+	skipSpaces( ctx, &ctx.pCur );
+
+	// these chars can't start an equation
+
+	s = ctx.pCur;
+
+	switch( peek( ctx, s ) )
+	{
+	case '}':
+		ok = checkError( ctx, s, ex_missing_lbrace );
+		break;
+	case '^':
+		ok = checkError( ctx, s, ex_prefix_superscript );
+		break;
+	case '_':
+		ok = checkError( ctx, s, ex_prefix_subscript );
+		break;
+	case '&':
+		ok = checkError( ctx, s, ex_misplaced_column_separator );		
+		break;
+	default:
+		ok = true;
+	}
+
+	if( !ok )
+	{
+		return false;
+	}
+
+	ctx.pChecked = s;
+
+	return true;
+}
+
+// checks the input from where the last call stopped up to 'until', or to
+// the end when 'until' is NULL
+
+static bool checkInput( ConverterContext &ctx, const char *until )
+{
+	char *s;
+
+	s = ctx.pChecked;
+
+	while( peek( ctx, s ) && ( ( until == NULL ) || ( s < until ) ) )
+	{
+		if( peek( ctx, s ) == '{' )
+		{
+			ctx.lastLeftBrace = s;
+			openBrace( ctx, s );
+			skipChar( ctx, &s );			
+			if( peek( ctx, s ) == '}' )
+			{
+				closeBrace( ctx, s );
+				skipChar( ctx, &s );
+			}			
+			switch( peek( ctx, s ) )
+			{
+			case '^':
+				if( !checkError( ctx, s, ex_prefix_superscript ) )
+				{
+					return false;
+				}
+				break;
+			case '_':
+				if( !checkError( ctx, s, ex_prefix_subscript ) )
+				{
+					return false;
+				}
+				break;
+			}
+		}
+		else if( peek( ctx, s ) == '}' )
+		{
+			if( ctx.openCount != 0 )
+			{
+				closeBrace( ctx, s );
+			}
+			else if( !checkError( ctx, s, ex_more_rbrace_than_lbrace ) )
+			{
+				return false;
+			}
+			++s;
+		}
+		else if( peek( ctx, s ) == char_backslash )
+		{
+			++s;
+			if( isDigit( peek( ctx, s ) ) )
+			{
+				if( !checkError( ctx, s-1, ex_undefined_control_sequence ) )
+				{
+					return false;
+				}
+			}
+			else if( isAlpha( peek( ctx, s ) ) )
+			{
+				char *start;
+
+				start = s;
+
+				// compute the length of the control name
+				do
+				{
+					++s;
+				} 
+				while( isAlpha( peek( ctx, s ) ) );
+
+				if( ( s - start ) > MAX_CONTROL_NAME )
+				{
+					if( !checkError( ctx, start - 1, ex_control_name_too_long ) )
+					{
+						return false;
+					}
+				}
+			}
+			else
+			{
+				// only the following chars can be escaped
+
+				switch( peek( ctx, s ) )
+				{		
+				case '}':
+				case '{':
+				case '&':
+				case '^':
+				case '_':
+				case '-':
+				case '$':
+				case '#':				
+				case '!':
+				case ';':
+				case '>':
+				case ':':	// check
+				case ',':
+				case '|':
+				case ' ':
+					++s;
+					break;
+				case char_backslash:
+					skipChar( ctx, &s );
+					if( scriptNext( ctx, s ) )
+					{
+						if( peek( ctx, s ) == '_' )
+						{
+							if( !checkError( ctx, s, ex_prefix_subscript ) )
+							{
+								return false;
+							}
+						}
+						else
+						{
+							if( !checkError( ctx, s, ex_prefix_superscript ) )
+							{
+								return false;
+							}
+						}
+					}
+					break;
+				default:
+					if( !checkError( ctx, s-1, ex_undefined_control_sequence ) )
+					{
+						return false;
+					}
+				}		
+			}
+		}
+		else if( peek( ctx, s ) == '&' )
+		{			
+			skipChar( ctx, &s );
+			if( scriptNext( ctx, s ) )
+			{
+				if( peek( ctx, s ) == '_' )
+				{					
+					if( !checkError( ctx, s, ex_prefix_subscript ) )
+					{
+						return false;
+					}
+				}
+				else
+				{
+					if( !checkError( ctx, s, ex_prefix_superscript ) )
+					{
+						return false;
+					}
+				}
+			}
+		}
+		else if( peek( ctx, s ) == '$' )
+		{
+			if( ctx.openCount == 0 )
+			{
+				if( !checkError( ctx, s, ex_misplaced_inline_formula ) )
+				{
+					return false;
+				}
+			}
+
+			skipChar( ctx, &s );
+			if( scriptNext( ctx, s ) )
+			{
+				if( peek( ctx, s ) == '_' )
+				{
+					if( !checkError( ctx, s, ex_prefix_subscript ) )
+					{
+						return false;
+					}
+				}
+				else
+				{
+					if( !checkError( ctx, s, ex_prefix_superscript ) )
+					{
+						return false;
+					}
+				}
+			}
+		}
+		else if( scriptNext( ctx, s ) )
+		{
+			char *pos;
+
+			pos = s;
+			skipChar( ctx, &s );
+			switch( peek( ctx, s ) )
+			{
+			case char_null:
+			case '}':
+			case '$':
+			case '&':
+				if( !checkError( ctx, pos, ex_missing_parameter ) )
+				{
+					return false;
+				}
+				break;
+			case char_backslash:
+				if( peek( ctx, s, 1 ) == char_backslash ) // row separator
+				{
+					if( !checkError( ctx, pos, ex_missing_parameter ) )
+					{
+						return false;
+					}
+				}				
+			}
+		}
+		else
+		{
+			s = (char *) scanPlain( s + 1, ctx.pEnd );
+		}
+		
+	}
+
+
+	ctx.pChecked = s;
+
+	return true;
+}
+
+static bool checkAhead( ConverterContext &ctx )
+{
+	if( ctx.pEnd - ctx.pChecked > CHECK_AHEAD )
+	{
+		return checkInput( ctx, ctx.pChecked + CHECK_AHEAD );
+	}
+	else
+	{
+		return checkInput( ctx, NULL );
+	}
+}
+
+static bool finishChecks( ConverterContext &ctx )
+{
+	if( !checkInput( ctx, NULL ) )
+	{
+		return false;
+	}
+
+	if( ( ctx.openCount != 0 ) && !checkError( ctx, ctx.lastLeftBrace, ex_more_lbrace_than_rbrace ) )
+	{
+		return false;
+	}
+
+	return true;
+}
+
+// sets 'close' to the '}' that closes the '{' at p, or to NULL if there
+// is none; false if the checks failed on the way
+
+static bool matchBrace( ConverterContext &ctx, const char *p, char **close )
+{
+	size_t low, high, mid;
+
+	*close = NULL;
+
+	while( ( ctx.pChecked <= p ) && ( peek( ctx, ctx.pChecked ) != char_null ) )
+	{
+		if( !checkAhead( ctx ) )
+		{
+			return false;
+		}
+	}
+
+	// the pairs are in the order of their '{'
+
+	low  = 0;
+	high = ctx.braceCount;
+
+	while( low < high )
+	{
+		mid = ( low + high ) / 2;
+
+		if( ctx.bracePairs[mid].open < p )
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	if( ( low == ctx.braceCount ) || ( ctx.bracePairs[low].open != p ) )
+	{
+		return true;
+	}
+
+	while( ( ctx.bracePairs[low].close == NULL ) && ( peek( ctx, ctx.pChecked ) != char_null ) )
+	{
+		if( !checkAhead( ctx ) )
+		{
+			return false;
+		}
+	}
+
+	*close = ctx.bracePairs[low].close;
+
+	return true;
+}
+
+// the '}' that closes the '{' at ctx.pCur, or NULL after an error.
+// Without one the checks fail with their own error, which replaces this one
+
+static char *getClosingBrace( ConverterContext &ctx )
+{
+	char *close;
+
+	if( !matchBrace( ctx, ctx.pCur, &close ) )
+	{
+		return NULL;
+	}
+
+	if( close == NULL )
+	{
+		error( ctx, ctx.pCur, ex_more_lbrace_than_rbrace );
+	}
+
+	return close;
+}
+
+static void skipSpaces( ConverterContext &ctx, char **p )
+{
+	char *s;
+
+	if( p == NULL )
+	{
+		return;
+	}
+
+	s = *p;
+
+	while( isSpace( peek( ctx, s ) ) )
+	{
+		++s;
+	}
+
+	*p = s;
+}
+
+static void skipChar( ConverterContext &ctx, char **p )
+{
+	char *s;
+
+	if( p == NULL )
+	{
+		return;
+	}
+
+	s = *p;
+
+	if( s < ctx.pEnd )
+	{
+		++s; // skip one char, then spaces
+	}
+
+	while( isSpace( peek( ctx, s ) ) )
+	{
+		++s;
+	}
+
+	*p = s;
+}
+
+
+static bool followedBy( ConverterContext &ctx, char **p, const char *pattern, skip_input skip )
+{
+	char *s;
+
+	if( p == NULL )
+	{
+		return false;
+	}
+
+	s = *p;
+
+	do {
+		if( peek( ctx, s ) == *pattern )
+		{
+			++s;
+			++pattern;
+		}
+		else
+		{
+			return false;
+		}
+	} while( peek( ctx, s ) && *pattern );
+
+	if( ( *pattern == char_null ) && !isAlpha( peek( ctx, s ) ) )
+	{
+		if( skip != sp_no_skip )
+		{
+			if( isSpace( peek( ctx, s ) ) )
+			{
+				skipSpaces( ctx, &s );
+			}
+			*p = s;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+
+static bool scriptNext( ConverterContext &ctx, char *p )
+{
+	char c = peek( ctx, p );
+
+	return ( c == '_' ) || ( c == '^' );
+}
+
+static bool getInput( ConverterContext &ctx, InputStream &input, skip_input white_space )
+{
+	int i;
+
+	// only the fields a token reads are set; the buffer holds a string
+	input.token = token_unknown;
+	input.start = NULL;
+	input.buffer[0] = char_null;
+	input.nextChar = char_null;
+	input.symbol = NULL;
+	input.control = NULL;
+
+	if( white_space == sp_skip_all )
+	{
+		if( isSpace( peek( ctx, ctx.pCur ) ) )
+		{
+			skipSpaces( ctx, &ctx.pCur );
+		}
+	}
+
+	while( ( ctx.pChecked <= ctx.pCur ) && ( peek( ctx, ctx.pChecked ) != char_null ) )
+	{
+		if( !checkAhead( ctx ) )
+		{
+			input.token = token_error;
+			return false;
+		}
+	}
+	
+	if( peek( ctx, ctx.pCur ) == char_null )
+	{
+		input.token = token_eof;
+		return false;
+	}
+
+	
+	while( peek( ctx, ctx.pCur ) )
+	{
+		input.start = ctx.pCur;
+
+		switch( charClass( peek( ctx, ctx.pCur ) ) )
+		{
+		case cc_alpha:
+			input.token = token_alpha;
+			return true;
+		case cc_digit:
+			input.token = token_digit;
+			return true;
+		case cc_column_sep:
+			input.token = token_column_sep;
+			skipChar( ctx, &ctx.pCur );
+			return true;
+		case cc_left_brace:
+			input.token = token_left_brace;
+			skipChar( ctx, &ctx.pCur );
+			return true;
+		case cc_right_brace:
+			input.token = token_right_brace;
+			skipChar( ctx, &ctx.pCur );
+			return true;
+		case cc_superscript:
+			input.token = token_superscript;
+			skipChar( ctx, &ctx.pCur );
+			return true;
+		case cc_subscript:
+			input.token = token_subscript;
+			skipChar( ctx, &ctx.pCur );
+			return true;
+		case cc_space:
+			if( ( peek( ctx, ctx.pCur ) == ' ' ) && ( white_space == sp_skip_once ) )
+			{
+				input.token = token_white_space;
+				++ctx.pCur;
+				return true;
+			}
+			// other spaces \n\r, or spaces to skip
+			skipSpaces( ctx, &ctx.pCur );
+			break;
+		case cc_backslash:
+			++ctx.pCur;
+			if( isAlpha( peek( ctx, ctx.pCur ) ) )
+			{
+				input.token = token_control_name;		
+				i = 0;
+				do
+				{					
+					input.buffer[i++] = peek( ctx, ctx.pCur );
+					++ctx.pCur;
+				}
+				while( ( i < MAX_CONTROL_NAME ) && isAlpha( peek( ctx, ctx.pCur ) ) );
+
+				input.buffer[i] = char_null;
+				input.control = findControl( input.buffer, ctx.style );
+				// use this to determine whether control name 
+				// is followed IMMEDIATELY by digits
+				// cf. \abc123 vs.\abc   123
+				input.nextChar = peek( ctx, ctx.pCur );
+				if( isSpace( peek( ctx, ctx.pCur ) ) )
+				{
+					skipSpaces( ctx, &ctx.pCur );
+				}
+			}
+			else
+			{
+				if( peek( ctx, ctx.pCur ) == char_backslash )
+				{
+					input.token  = token_row_sep;
+				}
+				else
+				{
+					input.token  = token_control_symbol;
+				}
+				input.buffer[0] = char_backslash;
+				input.buffer[1] = peek( ctx, ctx.pCur );
+				input.buffer[2] = char_null;
+				input.symbol = getSymbol( input.buffer, ctx.style );
+				skipChar( ctx, &ctx.pCur );				
+				input.nextChar = peek( ctx, ctx.pCur );
+			}
+			return true;
+		case cc_right_sq_bracket:
+			input.token  = token_right_sq_bracket;
+			input.buffer[0] = peek( ctx, ctx.pCur );
+			input.buffer[1] = char_null;
+			input.symbol = getSymbol( input.buffer, ctx.style );
+			skipChar( ctx, &ctx.pCur );				
+			input.nextChar = peek( ctx, ctx.pCur );
+			return true;
+		case cc_inline_math:
+			input.token  = token_inline_math;
+			input.buffer[0] = peek( ctx, ctx.pCur );
+			input.buffer[1] = char_null;
+			//skipChar( ctx, &ctx.pCur ); don't skip
+			input.nextChar = peek( ctx, ctx.pCur );
+			return true;
+		case cc_prime:
+			input.token  = token_prime;
+			input.buffer[0] = peek( ctx, ctx.pCur );			
+			input.buffer[1] = char_null;
+			input.nextChar = peek( ctx, ctx.pCur, 1 );
+			// don't skip
+			return true;
+		default:	// symbols
+			input.token  = token_symbol;
+			input.buffer[0] = peek( ctx, ctx.pCur );
+			input.buffer[1] = char_null;
+			input.symbol = getSymbol( input.buffer, ctx.style );
+			skipChar( ctx, &ctx.pCur );				
+			input.nextChar = peek( ctx, ctx.pCur );
+			return true;
+		}
+	}
+
+	return true;
+}
+
+/*
+
+ THE TREE is built in the arena as the input is read. A token points to
+ its markup in the tables, or to a copy when it is put together from the
+ input; an element has its start and end tags and its children. A row
+ is counted as it grows: it becomes an <mrow> only if it ends up with
+ more than one element
+
+*/
+
+static MathNode *addToken( ConverterContext &ctx, MathNode *row, node_type type, const char *text, size_t len )
+{
+	MathNode *node = newNode( ctx.arena, type, text, len );
+
+	addChild( row, node );
+
+	return node;
+}
+
+template <size_t N> static MathNode *addLiteral( ConverterContext &ctx, MathNode *row, node_type type, const char (&s)[N] )
+{
+	return addToken( ctx, row, type, s, N - 1 );
+}
+
+// a token made of 'tagOn', 'len' bytes of 's' and 'tagOff', copied
+
+static MathNode *addText( ConverterContext &ctx, MathNode *row, node_type type, const char *tagOn, const char *s, size_t len, const char *tagOff )
+{
+	size_t onLen, offLen;
+	char *text;
+
+	onLen  = strlen( tagOn );
+	offLen = strlen( tagOff );
+	text   = (char *) ctx.arena.alloc( onLen + len + offLen );
+
+	memcpy( text, tagOn, onLen );
+	memcpy( text + onLen, s, len );
+	memcpy( text + onLen + len, tagOff, offLen );
+
+	return addToken( ctx, row, type, text, onLen + len + offLen );
+}
+
+// a copy of what was written to 'buf', which may be in its own storage
+
+static const char *keepText( ConverterContext &ctx, Buffer &buf )
+{
+	char *text;
+
+	text = (char *) ctx.arena.alloc( buf.length() + 1 );
+	memcpy( text, buf.data(), buf.length() + 1 );
+
+	return text;
+}
+
+static MathNode *newElement( ConverterContext &ctx, node_type type, const char *tagOn, const char *tagOff )
+{
+	MathNode *node = newNode( ctx.arena, type, tagOn, strlen( tagOn ) );
+
+	node->textOff = tagOff;
+	node->lenOff  = (unsigned int) strlen( tagOff );
+
+	return node;
+}
+
+// the token a symbol of the tables makes
+
+static node_type symbolType( math_type mathType )
+{
+	switch( mathType )
+	{
+	case mt_ident:
+		return nt_identifier;
+	case mt_digit:
+		return nt_number;
+	case mt_text:
+		return nt_text;
+	default:
+		return nt_operator;
+	}
+}
+
+// a group parsed on its own goes to 'dest': nothing if it is empty, its
+// element if it has one, or else the whole row as an <mrow>
+
+static void appendRow( MathNode *dest, MathNode *row )
+{
+	if( row->count == 1 )
+	{
+		addChild( dest, row->first );
+	}
+	else if( row->count > 1 )
+	{
+		addChild( dest, row );
+	}
+}
+
+// drops the children of 'row' after 'mark', which was its last child
+// when it had 'count' children; NULL drops them all
+
+static void truncateRow( MathNode *row, MathNode *mark, size_t count )
+{
+	if( mark != NULL )
+	{
+		mark->next = NULL;
+	}
+	else
+	{
+		row->first = NULL;
+	}
+	row->last  = mark;
+	row->count = count;
+}
+
+// the element a script at this point of the group applies to: the last
+// one of its node, unless the group hasn't added it
+
+static MathNode *scriptBase( const ParseFrame *frame )
+{
+	return ( frame->node->last != frame->before ) ? frame->node->last : NULL;
+}
+
+static void onPrime( ConverterContext &ctx, MathNode *row )
+{
+	const SymbolStruct *sym;
+	char buf[5];
+
+	getPrime( ctx, &ctx.pCur, buf );
+
+	sym = getSymbol( buf, ctx.style );
+
+	addToken( ctx, row, nt_operator, sym->element, strlen( sym->element ) );
+}
+
+static void getPrime( ConverterContext &ctx, char **p, char *buf )
+{
+	int i = 0;
+	do {
+		*buf = **p;
+		++buf;
+		++(*p);
+		++i;
+		if( i == 3 )
+		{
+			break;
+		}
+	} while( peek( ctx, *p ) == char_prime );
+
+	*buf = char_null;
+
+	if( isSpace( peek( ctx, *p ) ) )
+	{		
+		skipSpaces( ctx, p );
+	}
+}
+
+static token_type getControlTypeEx( ConverterContext &ctx, InputStream &input, ControlStruct &control )
+{
+	Buffer buf( &ctx.arena );		
+
+	control.start = input.start;
+	input.token		  = getControlType( input.control, control );
+
+	if( input.token != token_unknown )
+	{
+		return input.token;
+	}
+
+	if( isDigit( input.nextChar )  )
+	{
+		buf.write( input.buffer );	
+		buf.write( *ctx.pCur );		// write the next digit
+		++ctx.pCur;
+	}
+	else
+	{
+		return input.token;
+	}
+
+	while( ( input.token = getControlType( buf.data(), control, ctx.style ) ) == token_unknown )
+	{
+		if( isDigit( peek( ctx, ctx.pCur ) ) )
+		{
+			buf.write( *ctx.pCur );
+			++ctx.pCur;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	return input.token;
+}
+
+// takes the next frame of the parse stack
+
+static ParseFrame *pushFrame( ConverterContext &ctx )
+{
+	if( ctx.depth == ctx.frameCount )
+	{
+		if( ctx.frameSize == 0 )
+		{
+			ctx.frameSize = 16;
+			ctx.frames	  = (ParseFrame **) ctx.listArena.alloc( ctx.frameSize * sizeof( ParseFrame * ) );
+		}
+		else if( ctx.frameCount == ctx.frameSize )
+		{
+			ctx.frames	   = (ParseFrame **) ctx.listArena.resize( ctx.frames, ctx.frameSize * sizeof( ParseFrame * ), 2 * ctx.frameSize * sizeof( ParseFrame * ) );
+			ctx.frameSize *= 2;
+		}
+		ctx.frames[ctx.frameCount++] = (ParseFrame *) ctx.listArena.alloc( sizeof( ParseFrame ) );
+	}
+
+	return ctx.frames[ctx.depth++];
+}
+
+// a group whose elements go to 'node'; NULL if that would nest deeper
+// than the limit. Only groups count towards it
+
+static ParseFrame *pushGroup( ConverterContext &ctx, MathNode *node, sub_expression subType, void *paramExtra, bool owned )
+{
+	ParseFrame *frame;
+
+	if( ctx.groups > ctx.maxDepth )
+	{
+		error( ctx, ctx.pCur, ex_nesting_too_deep );
+		return NULL;
+	}
+
+	++ctx.groups;
+	frame = pushFrame( ctx );
+
+	frame->node		  = node;
+	frame->before	  = node->last;
+	frame->subType	  = subType;
+	frame->paramExtra = paramExtra;
+	frame->owned	  = owned;
+	frame->step		  = NULL;
+
+	return frame;
+}
+
+// a command whose element goes to 'row'; runLoop() calls 'step' when
+// the frame is on top, first right away and then after each argument
+// in braces
+
+static ParseFrame *pushCommand( ConverterContext &ctx, StepFunc step, MathNode *row )
+{
+	ParseFrame *frame = pushFrame( ctx );
+
+	frame->node	   = row;
+	frame->step	   = step;
+	frame->stage   = 0;
+	frame->element = NULL;
+	frame->extra   = NULL;
+
+	return frame;
+}
+
+// the frame is still there until the next one is pushed
+
+static ParseFrame *popFrame( ConverterContext &ctx )
+{
+	ParseFrame *frame = ctx.frames[--ctx.depth];
+
+	if( frame->step == NULL )
+	{
+		--ctx.groups;
+	}
+
+	return frame;
+}
+
+/*
+
+ RECOVERY: after an error the parse skips to the next place where the
+ group it is in can go on - the '}' or the end that closes it, a column
+ or row separator, the closing '$' of an inline formula, or an \end or
+ \right - and writes the skipped source as an <merror>. An unknown
+ name or character, or a stray separator, spoils only itself: the parse
+ goes on right after it. An error in the arguments of a command spoils
+ the command with its arguments, and an environment up to its \end
+
+*/
+
+static bool isResyncName( const char *p, const char *end, const char *name, size_t len )
+{
+	return ( (size_t) (end - p) >= len ) && ( memcmp( p, name, len ) == 0 ) &&
+		   ( ( p + len == end ) || !isAlpha( p[len] ) );
+}
+
+// the end of the token at 'start': a control name, a control symbol, or
+// one character with its UTF-8 continuation bytes
+
+static char *tokenEnd( ConverterContext &ctx, char *start )
+{
+	char *s = start + 1;
+
+	if( *start == '\\' )
+	{
+		if( !isAlpha( peek( ctx, s ) ) )
+		{
+			return ( s < ctx.pEnd ) ? s + 1 : s;
+		}
+		while( isAlpha( peek( ctx, s ) ) )
+		{
+			++s;
+		}
+	}
+	else
+	{
+		while( ( s < ctx.pEnd ) && ( ( *s & 0xC0 ) == 0x80 ) )
+		{
+			++s;
+		}
+	}
+
+	return s;
+}
+
+// the end of the fence after the \right that closes a \left whose name
+// ends at 'p'; NULL if there is none
+
+static char *fenceEnd( ConverterContext &ctx, char *p )
+{
+	size_t level = 1;
+
+	for( ; p < ctx.pEnd; ++p )
+	{
+		if( *p != char_backslash )
+		{
+			continue;
+		}
+
+		if( isResyncName( p + 1, ctx.pEnd, "left", 4 ) )
+		{
+			++level;
+		}
+		else if( isResyncName( p + 1, ctx.pEnd, "right", 5 ) && ( --level == 0 ) )
+		{
+			for( p += 6; ( p < ctx.pEnd ) && isSpace( *p ); ++p );
+
+			return ( p < ctx.pEnd ) ? tokenEnd( ctx, p ) : p;
+		}
+		else
+		{
+			++p;	// \\ or an escaped character
+		}
+	}
+
+	return NULL;
+}
+
+// the end of the arguments of the command whose name ends at 'p': each
+// in braces or brackets, with spaces between. An environment ends after
+// its \end, and a \left after the fence of its \right
+
+static char *argumentsEnd( ConverterContext &ctx, char *start, char *p )
+{
+	const char *end;
+	char *s, open;
+	size_t level;
+
+	if( isResyncName( start + 1, ctx.pEnd, "begin", 5 ) )
+	{
+		end = environmentEnd( ctx, p );
+
+		return ( end != NULL ) ? (char *) end : p;
+	}
+	else if( isResyncName( start + 1, ctx.pEnd, "left", 4 ) )
+	{
+		end = fenceEnd( ctx, p );
+
+		return ( end != NULL ) ? (char *) end : p;
+	}
+
+	while( 1 )
+	{
+		for( s = p; ( s < ctx.pEnd ) && isSpace( *s ); ++s );
+
+		if( ( s == ctx.pEnd ) || ( ( *s != '{' ) && ( *s != '[' ) ) )
+		{
+			return p;
+		}
+
+		open  = *s;
+		level = 0;
+
+		for( ; s < ctx.pEnd; ++s )
+		{
+			if( ( *s == char_backslash ) && ( s + 1 < ctx.pEnd ) )
+			{
+				++s;	// an escaped character doesn't count
+			}
+			else if( *s == '{' )
+			{
+				++level;
+			}
+			else if( *s == '}' )
+			{
+				if( ( level > 0 ) && ( --level == 0 ) && ( open == '{' ) )
+				{
+					break;
+				}
+			}
+			else if( ( *s == ']' ) && ( level == 0 ) && ( open == '[' ) )
+			{
+				break;
+			}
+		}
+
+		if( s == ctx.pEnd )
+		{
+			return p;	// not closed
+		}
+		p = s + 1;
+	}
+}
+
+static char *findResync( ConverterContext &ctx, char *start, sub_expression subType )
+{
+	char *s = start + ( ( *start == '\\' ) ? 2 : 1 );
+	char *end, *args;
+	size_t level = 0;
+
+	end = tokenEnd( ctx, start );
+
+	switch( ctx.errMsg.code )
+	{
+	case ex_undefined_control_sequence:
+	case ex_unknown_character:
+	case ex_misplaced_column_separator:
+	case ex_misplaced_row_separator:
+		// only if the error is in the token itself, not in an argument of it
+
+		if( ( ctx.errMsg.index >= (size_t) ( start - ctx.pStart ) ) && ( ctx.errMsg.index < (size_t) ( end - ctx.pStart ) ) )
+		{
+			return end;
+		}
+		break;
+	}
+
+	if( ( *start == char_backslash ) && ( ctx.errMsg.index >= (size_t) ( end - ctx.pStart ) ) )
+	{
+		args = argumentsEnd( ctx, start, end );
+
+		if( ctx.errMsg.index < (size_t) ( args - ctx.pStart ) )
+		{
+			return args;
+		}
+	}
+
+	if( s > ctx.pEnd )
+	{
+		s = ctx.pEnd;
+	}
+
+	while( s < ctx.pEnd )
+	{
+		switch( *s )
+		{
+		case '{':
+			++level;
+			break;
+		case '}':
+			if( level == 0 )
+			{
+				return s;
+			}
+			--level;
+			break;
+		case '&':
+			if( level == 0 )
+			{
+				return s;
+			}
+			break;
+		case '$':
+			if( ( level == 0 ) && ( subType == se_inline_math ) )
+			{
+				return s;
+			}
+			break;
+		case '\\':
+			if( level == 0 )
+			{
+				if( ( ( s + 1 < ctx.pEnd ) && ( s[1] == '\\' ) ) ||
+					isResyncName( s + 1, ctx.pEnd, "end", 3 ) || isResyncName( s + 1, ctx.pEnd, "right", 5 ) )
+				{
+					return s;
+				}
+			}
+			++s;	// an escaped character doesn't count
+			break;
+		}
+		++s;
+	}
+
+	return ctx.pEnd;
+}
+
+// false if the error can't be recovered from
+
+static bool recoverError( ConverterContext &ctx, MathNode *row, MathNode *mark, size_t count, char *start, sub_expression subType )
+{
+	Buffer text( &ctx.arena );
+	char *end, *last;
+
+	if( !ctx.recover || ( ctx.errMsg.code == ex_nesting_too_deep ) )
+	{
+		return false;
+	}
+
+	end = findResync( ctx, start, subType );
+
+	// the checks explain the errors they find: a parse error inside the
+	// same span follows from one of them
+
+	while( ( ctx.pChecked <= end ) && ( peek( ctx, ctx.pChecked ) != char_null ) )
+	{
+		checkAhead( ctx );
+	}
+
+	if( checkErrorIn( ctx, start, end ) )
+	{
+		ctx.errMsg.failed = false;
+	}
+	else
+	{
+		keepError( ctx );
+	}
+
+	ctx.pCur = end;
+
+	for( last = end; ( last > start ) && isSpace( last[-1] ); --last );
+
+	truncateRow( row, mark, count );
+	text.writeLiteral( "<merror><mtext>" );
+
+	for( ; start < last; ++start )
+	{
+		switch( *start )
+		{
+		case '<':
+			text.writeLiteral( "&lt;" );
+			break;
+		case '>':
+			text.writeLiteral( "&gt;" );
+			break;
+		case '&':
+			text.writeLiteral( "&amp;" );
+			break;
+		default:
+			text.write( *start );
+		}
+	}
+
+	text.writeLiteral( "</mtext></merror>" );
+	addToken( ctx, row, nt_error, keepText( ctx, text ), text.length() );
+
+	return true;
+}
+
+// an error in the token a group is on, or in a command it began: the
+// commands above the group are dropped and the group skips the token.
+// False if that can't be done
+
+static bool recoverToken( ConverterContext &ctx )
+{
+	ParseFrame *frame;
+
+	while( ( frame = ctx.frames[ctx.depth - 1] )->step != NULL )
+	{
+		--ctx.depth;
+	}
+
+	return recoverError( ctx, frame->node, frame->mark, frame->count, frame->start, frame->subType );
+}
+
+// the checks failed inside a group: it goes with the braced groups it
+// is in up to the one a command owns, and the error is that command's
+
+static bool dropGroup( ConverterContext &ctx )
+{
+	while( !popFrame( ctx )->owned );
+
+	return ( ctx.depth != 0 ) && recoverToken( ctx );
+}
+
+/*
+
+ STREAMING to an output sink: a table at the top level goes out a block
+ of rows at a time while it is parsed. What comes before it is final
+ once it begins, and its rows are final at each '\\', as long as
+ nothing after the table can put a script on it; the rest goes out at
+ the end
+
+*/
+
+enum { STREAM_CHUNK = 4096 };	// bytes of input a block of rows takes
+
+static void sendText( ConverterContext &ctx, const char *s, size_t len )
+{
+	ctx.sink( ctx.sinkUser, s, len );
+}
+
+template <size_t N> static void sendLiteral( ConverterContext &ctx, const char (&s)[N] )
+{
+	sendText( ctx, s, N - 1 );
+}
+
+// sends the text of a tree, written in one piece
+
+static void sendTree( ConverterContext &ctx, const MathNode *node )
+{
+	size_t len;
+
+	len = treeLength( node );
+
+	if( len != 0 )
+	{
+		ctx.streamBuf.reset();
+		writeTree( node, ctx.streamBuf.extend( len ) );
+		sendText( ctx, ctx.streamBuf.data(), len );
+	}
+}
+
+static void sendHeader( ConverterContext &ctx, bool mrow )
+{
+	if( ctx.display )
+	{
+		sendLiteral( ctx, mathDisplayOn );
+	}
+	else
+	{
+		sendLiteral( ctx, mathOn );
+	}
+
+	if( mrow )
+	{
+		sendLiteral( ctx, "<mrow>" );
+	}
+
+	ctx.streamed   = true;
+	ctx.streamMrow = mrow;
+}
+
+// past the \end{...} that closes the environment begun before p; NULL
+// if there is none
+
+static const char *environmentEnd( ConverterContext &ctx, const char *p )
+{
+	size_t level = 1;
+
+	for( ; p < ctx.pEnd; ++p )
+	{
+		if( *p != char_backslash )
+		{
+			continue;
+		}
+
+		if( isResyncName( p + 1, ctx.pEnd, "begin", 5 ) )
+		{
+			++level;
+		}
+		else if( isResyncName( p + 1, ctx.pEnd, "end", 3 ) && ( --level == 0 ) )
+		{
+			p = (const char *) memchr( p, '}', ctx.pEnd - p );
+
+			return ( p != NULL ) ? p + 1 : NULL;
+		}
+		else
+		{
+			++p;	// \\ or an escaped character
+		}
+	}
+
+	return NULL;
+}
+
+// true if there is an \eqno or \leqno at or past p. Names are read the
+// way getInput() reads them, so 'eqno' in the text of \text{eqno} or in
+// a longer name doesn't count. p is further on at each call, so the
+// search takes up where the last one stopped and reads the input once
+// for the whole conversion
+
+static bool equationNumberFollows( ConverterContext &ctx, const char *p )
+{
+	const char *name;
+	size_t len;
+
+	if( ( ctx.eqnoFound != NULL ) && ( ctx.eqnoFound >= p ) )
+	{
+		return true;
+	}
+	if( p < ctx.eqnoScanned )
+	{
+		p = ctx.eqnoScanned;
+	}
+
+	while( ( p = (const char *) memchr( p, char_backslash, ctx.pEnd - p ) ) != NULL )
+	{
+		name = ++p;
+
+		while( ( p < ctx.pEnd ) && isAlpha( *p ) )
+		{
+			++p;
+		}
+
+		len = p - name;
+
+		if( ( ( len == 4 ) && ( memcmp( name, "eqno", 4 ) == 0 ) ) || ( ( len == 5 ) && ( memcmp( name, "leqno", 5 ) == 0 ) ) )
+		{
+			ctx.eqnoFound	= name - 1;
+			ctx.eqnoScanned = p;
+
+			return true;
+		}
+		if( ( len == 0 ) && ( p < ctx.pEnd ) )
+		{
+			++p;	// \\ or an escaped character
+		}
+	}
+
+	ctx.eqnoFound	= NULL;
+	ctx.eqnoScanned = ctx.pEnd;
+
+	return false;
+}
+
+// at a \begin in the top-level group: sends what is before the
+// environment and lets it stream its rows, unless what follows its \end
+// could be a script or something that passes one on ({}^2). An equation
+// number wraps the whole formula, so nothing is sent before the end if
+// the formula has one: one before the environment is parsed by now, one
+// after it is looked for ahead
+
+static void startStream( ConverterContext &ctx, ParseFrame *top )
+{
+	MathNode *row = top->node;
+	const char *p;
+	bool follows;
+
+	if( ctx.isNumberedFormula || ( ( p = environmentEnd( ctx, ctx.pCur ) ) == NULL ) || equationNumberFollows( ctx, p ) )
+	{
+		return;
+	}
+
+	while( ( p < ctx.pEnd ) && isSpace( *p ) )
+	{
+		++p;
+	}
+
+	if( p == ctx.pEnd )
+	{
+		follows = false;
+	}
+	else if( isAlnum( *p ) || ( ( *p != char_null ) && ( strchr( "+-=<>,.;:!?()[]|/", *p ) != NULL ) ) )
+	{
+		follows = true;		// an element the <mrow> will hold too
+	}
+	else
+	{
+		return;
+	}
+
+	if( !ctx.streamed )
+	{
+		sendHeader( ctx, follows || ( row->count != 0 ) );
+	}
+
+	// the <mrow> is sent: the row holds the rest with no tags of its own
+
+	row->type = nt_list;
+	sendTree( ctx, row );
+	truncateRow( row, NULL, 0 );
+	top->before = NULL;
+
+	ctx.streamNext = true;		// for onBeginEnvironment()
+}
+
+// at a '\\' of a streaming table: its start tag, the rows done and the
+// separator in front of the new row go out. Nothing allocated since the
+// rows began is needed once they are sent, so the arena goes back to
+// where it stood then and the new row is made again; the checks forget
+// the braces of the rows too. The memory of a table stays that of a
+// block of rows
+
+static void streamRows( ConverterContext &ctx, ParseFrame *frame, ArrayStruct &ar )
+{
+	MathNode rows = *ar.table;
+
+	rows.lenOff = 0;
+	sendTree( ctx, &rows );
+
+	ar.table->len = 0;
+	truncateRow( ar.table, NULL, 0 );
+	ctx.arena.rewind( ar.rows );
+
+	ar.row = newNode( ctx.arena, nt_table_row );
+	addChild( ar.table, ar.row );
+
+	frame->node	  = newNode( ctx.arena, nt_cell );
+	frame->before = NULL;
+	addChild( ar.row, frame->node );
+
+	ar.rowsStart = ctx.pCur;
+	dropBraces( ctx, ctx.pCur );
+}
+
+static void finishStream( ConverterContext &ctx )
+{
+	if( !ctx.streamed )
+	{
+		if( outputLength( ctx ) == 0 )
+		{
+			return;
+		}
+		sendHeader( ctx, false );		// the <mrow> is in the tree
+	}
+
+	sendTree( ctx, ctx.output );
+
+	if( ctx.streamMrow )
+	{
+		sendLiteral( ctx, "</mrow>" );
+	}
+
+	sendLiteral( ctx, mathOff );
+}
+
+// parses the expression into 'node'; false after an error, which is in
+// ctx.errMsg. Every parse function returns false the same way. Nothing
+// recurses: a '{', an argument and a command waiting for its arguments
+// each get a frame of the parse stack, and the loop goes on with the
+// frame on top
+
+static bool runLoop( ConverterContext &ctx, MathNode *node )
+{
+	InputStream input;
+	ControlStruct control;	
+	ParseFrame *frame;
+	MathNode *row;
+	bool quitLoop, ok;
+
+	ZeroMemory( &control, sizeof( control ) );
+
+	if( pushGroup( ctx, node, se_use_default, NULL, true ) == NULL )
+	{
+		return false;
+	}
+
+	while( ctx.depth != 0 )
+	{
+		frame = ctx.frames[ctx.depth - 1];
+
+		if( frame->step != NULL )
+		{
+			// a command goes on with its next argument
+			if( !frame->step( ctx, frame ) && !recoverToken( ctx ) )
+			{
+				return false;
+			}
+			continue;
+		}
+
+		quitLoop = !getInput( ctx, input, sp_skip_all );	// at the end or after an error
+
+		if( !quitLoop )
+		{
+			if( ( ctx.sink != NULL ) && ( ctx.depth == 1 ) && ( input.token == token_control_name ) && ( strcmp( input.buffer, "begin" ) == 0 ) )
+			{
+				startStream( ctx, frame );
+			}
+
+			// what the row and the input were before the token, for recovery
+
+			row			 = frame->node;
+			frame->mark	 = row->last;
+			frame->count = row->count;
+			frame->start = input.start;
+			ok			 = true;
+
+			switch( input.token )
+			{
+			case token_alpha:
+				onAlpha( ctx, row );
+				break;
+
+			case token_digit:
+				onDigit( ctx, row );
+				break;
+
+			case token_prime:
+				onPrime( ctx, row );
+				break;
+			case token_symbol:
+			case token_control_symbol:		
+				ok = onSymbol( ctx, row, input );
+				break;
+			/*
+			case token_white_space:
+				onWhiteSpace( str );
+				break;
+			*/
+			case token_inline_math:
+
+				if( frame->subType != se_inline_math )
+				{
+					ok = error( ctx, ctx.pCur, ex_misplaced_inline_formula );
+				}
+				quitLoop = true;
+				break;
+			case token_left_brace:
+				// the elements of a group go to the row around it: {ab}^2
+				ok = ( pushGroup( ctx, row, se_braced, NULL, false ) != NULL );
+				break;
+			case token_right_brace:
+				// in recovery mode a '}' without a '{' is passed over
+				quitLoop = !( ctx.recover && ( ctx.depth == 1 ) );
+				break;
+			case token_right_sq_bracket:
+				if( frame->subType == se_optional_param )
+				{
+					quitLoop = true;
+				}
+				else
+				{
+					ok = onSymbol( ctx, row, input );
+				}
+				break;
+			case token_superscript:
+				ok = onSuperscript( ctx, scriptBase( frame ) );
+				break;
+			
+			case token_subscript:
+				ok = onSubscript( ctx, scriptBase( frame ) );
+				break;
+			
+			case token_column_sep:
+				if( frame->subType < se_matrix )
+				{
+					ok = error( ctx, input.start, ex_misplaced_column_separator );				
+				}
+				else
+				{
+					ok = onColumn( ctx, frame, input.start, *((ArrayStruct *)frame->paramExtra) );
+				}
+				break;
+			case token_row_sep:
+				if( frame->subType < se_matrix )
+				{
+					ok = error( ctx, input.start, ex_misplaced_row_separator );				
+				}
+				else
+				{
+					ArrayStruct &ar = *((ArrayStruct *)frame->paramExtra);
+
+					onRow( ctx, frame, ar );
+
+					if( ar.stream && ( ctx.pCur - ar.rowsStart >= STREAM_CHUNK ) )
+					{
+						streamRows( ctx, frame, ar );
+					}
+				}
+				break;		
+			case token_control_name:
+				//onControlName( str, input, quit );			
+
+					input.token = getControlTypeEx( ctx, input, control );
+
+					switch( input.token )
+					{		
+					case token_control_entity:
+						ok = onEntity( ctx, row, control );
+						break;				
+					case token_control_command:
+						ok = onCommand( ctx, row, control, frame->subType, frame->paramExtra, quitLoop );
+						break;
+					case token_control_function:
+						ok = onFunction( ctx, row, control );
+						break;
+					//case token_unknown:
+					default:
+						ok = error( ctx, input.start, ex_undefined_control_sequence );								
+					}
+
+				break;
+			default:
+				break;
+			}
+
+			if( !ok )
+			{
+				if( !recoverToken( ctx ) )
+				{
+					return false;
+				}
+				continue;
+			}
+
+			if( !quitLoop )
+			{
+				continue;
+			}
+		}
+
+		// the group ends
+
+		if( input.token == token_error )
+		{
+			if( !dropGroup( ctx ) )
+			{
+				return false;
+			}
+			continue;
+		}
+
+		if( !onEndExpression( ctx, frame->subType, input.token, control.command ) )
+		{
+			// the group is closed as it is
+			if( !ctx.recover )
+			{
+				return false;
+			}
+			keepError( ctx );
+		}
+
+		// back to the frame below: the enclosing group, or the command
+		// the group is an argument of
+		popFrame( ctx );
+	}
+
+	return true;
+}
+
+//se_optional_param, se_inline_math, se_fence,					 
+//					  se_matrix
+static bool onEndExpression( ConverterContext &ctx, sub_expression subType, token_type token, const CommandStruct *command )
+{
+	switch( subType )
+	{
+	case se_optional_param:
+		if( token != token_right_sq_bracket )
+		{
+			return error( ctx, ctx.pCur, ex_missing_right_sq_bracket );
+		}
+		break;
+	case se_inline_math:
+		if( token != token_inline_math )
+		{
+			return error( ctx, ctx.pCur, ex_missing_dollar_symbol );
+		}
+		break;
+	case se_matrix:
+		if( token != token_control_command )
+		{
+			return error( ctx, ctx.pCur, ex_missing_end );
+		}
+		else if( command->id != ci_end )
+		{
+			return error( ctx, ctx.pCur, ex_missing_end );
+		}
+		break;
+	case se_fence:
+		if( token != token_control_command )
+		{
+			return error( ctx, ctx.pCur, ex_missing_right_fence );
+		}
+		else if( command->id != ci_right )
+		{
+			return error( ctx, ctx.pCur, ex_missing_right_fence );
+		}
+		break;
+	default:
+		break;
+	}
+
+	return true;
+}
+
+
+static void onAlpha( ConverterContext &ctx, MathNode *row )
+{
+	do {
+		addToken( ctx, row, nt_identifier, tokens.text[ (unsigned char) *ctx.pCur ], TOKEN_SIZE );
+		++ctx.pCur;
+	}
+	while( isAlpha( peek( ctx, ctx.pCur ) ) );
+}
+
+static void onDigit( ConverterContext &ctx, MathNode *row )
+{
+	char *start;
+
+	start = ctx.pCur;
+
+	do {		
+		++ctx.pCur;
+	}
+	while( isDigit( peek( ctx, ctx.pCur ) ) );
+
+	if( ctx.pCur - start == 1 )
+	{
+		addToken( ctx, row, nt_number, tokens.text[ (unsigned char) *start ], TOKEN_SIZE );
+	}
+	else
+	{
+		addText( ctx, row, nt_number, "<mn>", start, ctx.pCur - start, "</mn>" );
+	}
+}
+
+static bool onSymbol( ConverterContext &ctx, MathNode *row, InputStream &input, bool checkSubSup )
+{
+	const SymbolStruct *symbol;
+
+	symbol = input.symbol;
+
+	if( symbol == NULL )
+	{
+		return error( ctx, ctx.pCur, ex_unknown_character );
+	}
+
+	
+	switch( symbol->mathType )
+	{
+	case mt_fence:
+	case mt_left_fence:
+	case mt_right_fence:
+		if( checkSubSup && scriptNext( ctx, ctx.pCur ) )
+		{
+			return error( ctx, ctx.pCur, ex_ambiguous_script );
+		}
+		break;
+	default:
+		break;
+	}
+
+	addToken( ctx, row, symbolType( symbol->mathType ), symbol->element, strlen( symbol->element ) );
+
+	return true;
+}
+
+// adds the parameter to 'dest' as one node: a braced one as a row, a
+// group that runLoop() parses once this returns
+
+static bool getCommandParam( ConverterContext &ctx, MathNode *dest, sub_expression subType )
+{
+	InputStream input;
+	ControlStruct control;
+
+	getInput( ctx, input, sp_skip_all );
+
+	switch( input.token )
+	{
+	case token_alpha:
+		addToken( ctx, dest, nt_identifier, tokens.text[ (unsigned char) *ctx.pCur ], TOKEN_SIZE );
+		skipChar( ctx, &ctx.pCur );
+		break;
+
+	case token_digit:
+		addToken( ctx, dest, nt_number, tokens.text[ (unsigned char) *ctx.pCur ], TOKEN_SIZE );
+		skipChar( ctx, &ctx.pCur );
+		break;
+	case token_prime:
+		if( ctx.style & STYLE_COMPACT )
+		{
+			addLiteral( ctx, dest, nt_operator, "<mo>\xE2\x80\xB2</mo>" );	// U+2032 in UTF-8
+		}
+		else
+		{
+			addLiteral( ctx, dest, nt_operator, "<mo>&#x02032;</mo>" );
+		}
+		skipChar( ctx, &ctx.pCur );
+		break;
+	case token_symbol:
+	case token_control_symbol:
+		return onSymbol( ctx, dest, input, false ); // ignore subscript/superscript
+
+	case token_left_brace:
+		{
+			MathNode *row = newNode( ctx.arena, nt_row );
+
+			addChild( dest, row );
+
+			return pushGroup( ctx, row, ( subType == se_use_default ) ? se_braced : subType, NULL, true ) != NULL;
+		}
+
+	case token_right_brace:			
+	case token_superscript:
+	case token_subscript:
+	case token_column_sep:
+	case token_row_sep:
+	case token_eof:
+		return error( ctx, ctx.pCur, ex_missing_parameter );		
+
+	case token_error:
+		return false;
+
+	case token_control_name:
+			//onControlName( str, input, quit );			
+
+		input.token = getControlTypeEx( ctx, input, control );
+
+		switch( input.token )
+		{		
+		case token_control_entity:
+			// don't check limits and subscript
+			return onEntity( ctx, dest, control, false, false );
+		case token_control_command:
+			if( control.command->id == ci_frac )
+			{
+				bool quit;
+
+				return onCommand( ctx, dest, control, se_use_default, NULL, quit );
+			}
+			else
+			{
+				return error( ctx, input.start, ex_no_command_allowed );
+			}
+			break;
+		case token_control_function:
+			return onFunction( ctx, dest, control, false );
+		//case token_unknown:
+		default:
+			return error( ctx, input.start, ex_undefined_control_sequence );								
+		}
+		break;
+	default:
+		break;
+	}
+
+	return true;
+}
+
+// what may not follow a superscript
+
+static bool checkSuperscript( ConverterContext &ctx, bool subsup )
+{
+	if( ( peek( ctx, ctx.pCur ) == '^' ) || ( peek( ctx, ctx.pCur ) == char_prime ) )
+	{
+		return error( ctx, ctx.pCur, ex_double_superscript );
+	}
+	else if( peek( ctx, ctx.pCur ) == '_' )
+	{
+		if( subsup )
+		{
+			return error( ctx, ctx.pCur, ex_double_subscript );
+		}
+		else
+		{
+			return error( ctx, ctx.pCur, ex_use_subscript_before_superscript );
+		}
+	}
+
+	return true;
+}
+
+// 'scripts' holds the scripts of 'base', which becomes the first child
+// of the script element in the place it had
+
+static void wrapScript( ConverterContext &ctx, MathNode *base, MathNode *scripts, const SymbolTable &tags )
+{
+	scripts->type	 = nt_script;
+	scripts->text	 = tags.tagOn;
+	scripts->len	 = (unsigned int) strlen( tags.tagOn );
+	scripts->textOff = tags.tagOff;
+	scripts->lenOff	 = (unsigned int) strlen( tags.tagOff );
+
+	wrapNode( ctx.arena, base, scripts );
+}
+
+// the scripts of 'base' after a '_' (ci_msub) or a '^' (ci_msup): a
+// subscript may have a superscript after it. 'tags' are the elements for
+// each kind; see stepScripts()
+
+static bool readScripts( ConverterContext &ctx, MathNode *base, command_id which, const SymbolTable *tags )
+{
+	ParseFrame *frame = pushCommand( ctx, stepScripts, NULL );
+
+	frame->id	   = which;
+	frame->tags	   = tags;
+	frame->element = base;
+	frame->extra   = newNode( ctx.arena, nt_list );
+
+	return true;
+}
+
+// the base is wrapped once the scripts are there: after an error the
+// row is as it was
+
+static bool stepScripts( ConverterContext &ctx, ParseFrame *frame )
+{
+	MathNode *scripts = frame->extra;
+
+	switch( frame->stage++ )
+	{
+	case 0:
+		if( peek( ctx, ctx.pCur ) == char_prime )
+		{
+			return error( ctx, ctx.pCur, ex_missing_lbrace );
+		}
+		return getCommandParam( ctx, scripts, se_use_default );
+
+	case 1:
+		if( frame->id == ci_msup )
+		{
+			if( !checkSuperscript( ctx, false ) )
+			{
+				return false;
+			}
+		}
+		else if( peek( ctx, ctx.pCur ) == '^' )
+		{
+			skipChar( ctx, &ctx.pCur );
+			frame->id = ci_msubsup;
+
+			if( peek( ctx, ctx.pCur ) == char_prime )
+			{
+				return error( ctx, ctx.pCur, ex_missing_lbrace );
+			}
+			return getCommandParam( ctx, scripts, se_use_default );
+		}
+		else if( peek( ctx, ctx.pCur ) == char_prime )
+		{		
+			onPrime( ctx, scripts );
+			frame->id = ci_msubsup;
+		}
+		break;
+
+	default:	// the superscript after a subscript
+		if( !checkSuperscript( ctx, true ) )
+		{
+			return false;
+		}
+		break;
+	}
+
+	wrapScript( ctx, frame->element, scripts, frame->tags[frame->id - ci_msub] );
+	popFrame( ctx );
+
+	return true;
+}
+
+static bool onSuperscript( ConverterContext &ctx, MathNode *base )
+{
+	if( base == NULL )
+	{
+		return error( ctx, ctx.pCur, ex_missing_subsup_base );
+	}
+
+	return readScripts( ctx, base, ci_msup, nolimits );
+}
+
+static bool onSubscript( ConverterContext &ctx, MathNode *base )
+{
+	if( base == NULL )
+	{
+		return error( ctx, ctx.pCur, ex_missing_subsup_base );
+	}	
+
+	return readScripts( ctx, base, ci_msub, nolimits );
+}
+
+
+
+enum limits_type { lt_default, lt_subsup, lt_underover };
+
+// 'base' is the operator taking the limits
+
+static bool onLimits( ConverterContext &ctx, MathNode *base, math_type mathType )
+{
+	limits_type useLimits;
+
+	useLimits = lt_default;
+
+	do {
+		if( followedBy( ctx, &ctx.pCur, "\\limits", sp_skip_all ) )
+		{
+			useLimits = lt_underover;
+		}
+		else if( followedBy( ctx, &ctx.pCur, "\\nolimits", sp_skip_all ) )
+		{
+			useLimits = lt_subsup;
+		}
+		else
+		{
+			break;
+		}
+	} while( 1 );
+
+	if( peek( ctx, ctx.pCur ) == char_null )
+	{
+		return true;
+	}
+	else if( scriptNext( ctx, ctx.pCur ) || peek( ctx, ctx.pCur ) == char_prime )
+	{
+		MathNode *scripts;
+		const SymbolTable *lim;
+
+		if( useLimits == lt_underover )
+		{
+			lim = limits;
+		}
+		else if( useLimits == lt_subsup )
+		{
+			lim = nolimits;
+		}
+		else
+		{
+			if( mathType == mt_limits )
+			{
+				lim = nolimits;
+			}
+			else
+			{
+				lim = limitsMovable;
+			}
+		}
+
+		if( peek( ctx, ctx.pCur ) == '_' )
+		{		
+			skipChar( ctx, &ctx.pCur );
+			return readScripts( ctx, base, ci_msub, lim );
+		}
+		else if( peek( ctx, ctx.pCur ) == '^' )
+		{
+			skipChar( ctx, &ctx.pCur );
+			return readScripts( ctx, base, ci_msup, lim );
+		}
+
+		// a prime
+		scripts = newNode( ctx.arena, nt_list );
+		onPrime( ctx, scripts );
+
+		if( !checkSuperscript( ctx, false ) )
+		{
+			return false;
+		}
+		wrapScript( ctx, base, scripts, lim[1] );
+	}	
+
+	return true;
+}
+
+static bool onEntity( ConverterContext &ctx, MathNode *row, const ControlStruct &control, bool checkLimits, bool checkSubSup )
+{
+	MathNode *node;
+
+	switch( control.entity->mathType )
+	{
+	case mt_ident:
+	case mt_digit:
+	case mt_ord:	
+	case mt_punct:
+	case mt_text:
+	case mt_rel:
+	case mt_bin:
+	case mt_unary:
+	case mt_bin_unary:
+		addToken( ctx, row, symbolType( control.entity->mathType ), control.element->text, control.element->len );
+		break;
+	case mt_limits:
+	case mt_mov_limits:
+		
+		node = addToken( ctx, row, nt_operator, control.element->text, control.element->len );
+
+		if( checkLimits )
+		{
+			return onLimits( ctx, node, control.entity->mathType );
+		}
+		break;
+	case mt_left_fence:
+	case mt_right_fence:
+	case mt_fence:
+		if( checkSubSup && scriptNext( ctx, ctx.pCur ) )
+		{
+			return error( ctx, ctx.pCur, ex_ambiguous_script );
+		}
+		addToken( ctx, row, nt_operator, control.element->text, control.element->len );
+		break;
+	default:
+		return error( ctx, ctx.pCur, ex_unhandled_mathtype );
+	}
+
+	return true;
+}
+
+static bool onFunction( ConverterContext &ctx, MathNode *row, const ControlStruct &control, bool checkLimits  )
+{
+	MathNode *node;
+
+	node = addToken( ctx, row, nt_function, control.element->text, control.element->len );
+
+	if( ( control.function->mathType == mt_func_limits ) && checkLimits )
+	{
+		return onLimits( ctx, node, control.function->mathType );
+	}	
+
+	return true;
+}
+/*
+enum param_type { pt_unknown, pt_none, pt_one, pt_two, pt_three, pt_table, pt_others,
+				  pt_especial };
+*/
+
+static bool onSqrt( ConverterContext &ctx, MathNode *row, const char *tagOn, const char *tagOff )
+{
+	ParseFrame *frame;
+
+	if( peek( ctx, ctx.pCur ) == char_prime )			
+	{
+		return error( ctx, ctx.pCur, ex_missing_lbrace );
+	}
+
+	// the radix decides the element: stepSqrt() makes it
+
+	frame = pushCommand( ctx, stepSqrt, row );
+
+	frame->tagOn  = tagOn;
+	frame->tagOff = tagOff;
+	frame->extra  = newNode( ctx.arena, nt_row );
+
+	if( peek( ctx, ctx.pCur ) == '[' )
+	{
+		skipChar( ctx, &ctx.pCur );
+		return pushGroup( ctx, frame->extra, se_optional_param, NULL, true ) != NULL;
+	}
+
+	return true;
+}
+
+static bool stepSqrt( ConverterContext &ctx, ParseFrame *frame )
+{
+	MathNode *node, *radix = frame->extra;
+
+	if( frame->stage++ != 0 )
+	{
+		// the radix goes after the base
+		addChild( frame->element, radix );
+		popFrame( ctx );
+
+		return true;
+	}
+
+	if( radix->count != 0 )
+	{
+		frame->element = newElement( ctx, nt_root, "<mroot>", "</mroot>" );
+		addChild( frame->node, frame->element );
+
+		return getCommandParam( ctx, frame->element, se_use_default );
+	}
+
+	node = newElement( ctx, nt_root, frame->tagOn, frame->tagOff );
+	addChild( frame->node, node );
+	popFrame( ctx );
+
+	return getCommandParam( ctx, node, se_use_default );
+}
+
+// the attribute runs from ctx.pCur to 'close', which is skipped
+
+static void getAttribute( ConverterContext &ctx, Buffer &prevBuf, char *close )
+{
+	char *start, *end;
+	
+	start	 = ctx.pCur;
+	ctx.pCur = close;
+	
+	end = ctx.pCur - 1;
+
+
+	while( isSpace( *end ) )
+	{
+		--end;
+	}
+
+	if( *end == char_backslash )
+	{
+		end += 2;
+	}
+	else
+	{
+		end++;
+	}
+
+	if( end < start )	// only spaces
+	{
+		end = start;
+	}
+
+	prevBuf.write( start, (end - start ) );
+
+	skipChar( ctx, &ctx.pCur );
+
+}
+
+static bool getAttribute( ConverterContext &ctx, Buffer &prevBuf, char lastChar )
+{
+	char *close;
+	
+	close = ctx.pCur;
+
+	while( peek( ctx, close ) && ( *close != lastChar ) )
+	{
+		++close;
+	}
+
+	if( peek( ctx, close ) != lastChar )
+	{
+		return error( ctx, close, ex_missing_end_tag );
+	}
+
+	getAttribute( ctx, prevBuf, close );
+
+	return true;
+}
+
+static bool onMiMnMo( ConverterContext &ctx, MathNode *row, const char *tagOn, const char *tagOff, command_id id )
+{
+	Buffer str( &ctx.arena );
+	const char* attrib;
+	char *start;
+
+	if( peek( ctx, ctx.pCur ) == '[' )
+	{
+		start = ctx.pCur+1;
+		skipChar( ctx, &ctx.pCur );
+		if( !getAttribute( ctx, str, ']' ) )
+		{
+			return false;
+		}
+
+		attrib = getMathVariant( str.data() );
+
+		if( attrib == NULL )
+		{
+			return error( ctx, start, ex_unknown_attribute );
+		}
+
+		str.destroy();
+		str.write( tagOn, strlen(tagOn) - 1 ); // don't include '>'
+		str.writeLiteral( " mathvariant='" );
+		str.write( attrib );
+		str.writeLiteral( "'>" );		
+	}	
+	else
+	{
+		str.write( tagOn );		
+	}
+	return onMathFont( ctx, row, str.data(), tagOff, id );
+	//prevBuf.write( tagOff );			
+}
+
+
+// NULL after an error
+
+static const EnvironmentStruct *getEnvironmentType( ConverterContext &ctx )
+{
+	Buffer str( &ctx.arena );
+	char *curPos, *close;
+	const EnvironmentStruct *environment;
+
+	if( peek( ctx, ctx.pCur ) != '{' )
+	{
+		error( ctx, ctx.pCur, ex_missing_lbrace );
+		return NULL;
+	}
+
+	close = getClosingBrace( ctx );
+
+	if( close == NULL )
+	{
+		return NULL;
+	}
+
+	skipChar( ctx, &ctx.pCur);
+
+	curPos = ctx.pCur;
+
+	getAttribute( ctx, str, close );
+
+	environment = getEnvironmentType( str.data(), ctx.style );
+
+	if( environment == NULL )
+	{
+		error( ctx, curPos, ex_undefined_environment_type );
+	}	
+
+	return environment;
+}
+
+static bool getColumnAlignment( ConverterContext &ctx, Buffer &align, short &maxColumn, const char *tagOn )
+{
+	char *curPos, *p, *attrib, *close;
+	Buffer str( &ctx.arena );	
+
+	if( peek( ctx, ctx.pCur ) != '{' )
+	{
+		return error( ctx, ctx.pCur, ex_missing_lbrace );
+	}
+
+	close = getClosingBrace( ctx );
+
+	if( close == NULL )
+	{
+		return false;
+	}
+
+	skipChar( ctx, &ctx.pCur );
+
+	curPos = ctx.pCur;
+
+	getAttribute( ctx, str, close );
+
+	if( str.length() == 0 )
+	{
+		return error( ctx, ctx.pCur, ex_missing_column_alignment );
+	}
+
+	p = str.data();
+
+	maxColumn = 0;
+
+	attrib = (char *)strchr( tagOn, '>' );
+
+	align.write( tagOn, size_t( attrib - tagOn ) );
+	
+	align.writeLiteral( " columnalign='" );
+
+	while( *p )
+	{
+		switch( *p )
+		{
+		case 'l':
+			align.writeLiteral( "left" );			
+			break;
+		case 'c':
+			align.writeLiteral( "center" );			
+			break;
+		case 'r':
+			align.writeLiteral( "right" );			
+			break;
+		default:
+			if( isSpace( *p ) )
+			{
+				++p;
+				continue;
+			}
+			return error( ctx, curPos, 	ex_unknown_alignment_character );
+		}
+
+		++maxColumn;
+		++p;
+		if( *p )
+		{
+			align.writeLiteral( " " );
+		}
+	}
+	align.write( '\'' );
+	align.write( attrib );
+
+	return true;
+}
+
+static bool onBeginEnvironment( ConverterContext &ctx, MathNode *row  )
+{
+	ArrayStruct ar;
+	Buffer align( &ctx.arena );
+	const EnvironmentStruct *environment;
+	ParseFrame *frame;
+	MathNode *cell;
+
+	ar.stream	   = ctx.streamNext;
+	ctx.streamNext = false;
+
+	environment = getEnvironmentType( ctx );
+
+	if( environment == NULL )
+	{
+		return false;
+	}
+
+	ar.id		   = environment->id;	
+	ar.columnCount = 1;
+	ar.maxColumn   = 5000; // arbitrary	
+
+	
+
+	switch( environment->id )
+	{
+	case ci_array:
+		if( !getColumnAlignment( ctx, align, ar.maxColumn, environment->tagOn ) )
+		{
+			return false;
+		}
+		ar.table = newElement( ctx, nt_table, keepText( ctx, align ), environment->tagOff );
+		break;
+	case ci_eqnarray:
+		ar.maxColumn = 3; 
+		// fall through
+	default:		
+		ar.table = newElement( ctx, nt_table, environment->tagOn, environment->tagOff );
+		break;
+	}
+	addChild( row, ar.table );
+
+	if( ar.stream )
+	{
+		ar.rows		 = ctx.arena.mark();
+		ar.rowsStart = ctx.pCur;
+	}
+
+	ar.row = newNode( ctx.arena, nt_table_row );
+	cell   = newNode( ctx.arena, nt_cell );
+	addChild( ar.table, ar.row );
+	addChild( ar.row, cell );
+
+	// the cells are parsed after this returns: the table goes in their frame
+
+	frame = pushGroup( ctx, cell, se_matrix, NULL, true );
+
+	if( frame == NULL )
+	{
+		return false;
+	}
+
+	frame->array	  = ar;
+	frame->paramExtra = &frame->array;
+
+	return true;
+}
+
+static bool onEndEnvironment( ConverterContext &ctx, sub_expression subType, void *paramExtra )
+{
+	command_id id;
+	char *temp;	
+	const EnvironmentStruct *environment;
+
+	temp = ctx.pCur;
+	if( subType == se_matrix )
+	{
+		id = ((ArrayStruct *)paramExtra)->id;
+	}
+	else
+	{
+		return error( ctx, temp, ex_missing_begin );		
+	}
+
+	environment = getEnvironmentType( ctx );
+
+	if( environment == NULL )
+	{
+		return false;
+	}
+
+	if( environment->id != id )
+	{
+		return error( ctx, temp, ex_mismatched_environment_type );
+	}
+	return true;			
+}
+
+// a separator starts a new cell of the table, which the matrix group
+// goes on with
+
+static bool onColumn( ConverterContext &ctx, ParseFrame *frame, const char *pos, ArrayStruct &ar )
+{
+	++ar.columnCount;
+
+	if( ar.columnCount > ar.maxColumn )
+	{
+		return error( ctx, pos, ex_too_many_columns );
+	}
+
+	frame->node	  = newNode( ctx.arena, nt_cell );
+	frame->before = NULL;
+	addChild( ar.row, frame->node );
+
+	return true;
+}
+
+static void onRow( ConverterContext &ctx, ParseFrame *frame, ArrayStruct &ar )
+{
+	if( (peek( ctx, ctx.pCur ) == char_backslash ) && (peek( ctx, ctx.pCur, 1 ) == 'e' ) ) // \end?
+	{
+		if( followedBy( ctx, &ctx.pCur, "\\end", sp_no_skip ) )
+		{
+			return; // do nothing
+		}
+	}
+
+	ar.row = newNode( ctx.arena, nt_table_row );
+	addChild( ar.table, ar.row );
+
+	frame->node	  = newNode( ctx.arena, nt_cell );
+	frame->before = NULL;
+	addChild( ar.row, frame->node );
+
+	ar.columnCount = 1; // reset columns
+}
+
+
+static bool onHfill( ConverterContext &ctx, sub_expression subType )
+{
+	if( scriptNext( ctx, ctx.pCur ) )
+	{
+		if( peek( ctx, ctx.pCur ) == '^' )
+		{
+			return error( ctx, ctx.pCur, ex_prefix_superscript );
+		}
+		else
+		{
+			return error( ctx, ctx.pCur, ex_prefix_subscript );
+		}
+	}
+	if( subType < se_matrix ) // not in a table
+	{
+		return true;
+	}
+
+	return true;
+}
+
+static bool onArrows( ConverterContext &ctx, MathNode *row, const char *tagOn, const char *tagOff )
+{
+	ParseFrame *frame;
+
+	// stepArrows() makes the element once the underscript is read
+
+	frame = pushCommand( ctx, stepArrows, row );
+
+	frame->tagOn  = tagOn;
+	frame->tagOff = tagOff;
+	frame->extra  = newNode( ctx.arena, nt_row );
+
+	if( peek( ctx, ctx.pCur ) == '[' )
+	{
+		skipChar( ctx, &ctx.pCur );
+		return pushGroup( ctx, frame->extra, se_optional_param, NULL, true ) != NULL;
+	}
+
+	return true;
+}
+
+static bool stepArrows( ConverterContext &ctx, ParseFrame *frame )
+{
+	MathNode *node, *underscript = frame->extra;
+
+	//tagOn is the base
+	if( underscript->count != 0 )
+	{
+		node = newElement( ctx, nt_script, "<munderover>", "</munderover>" );
+		addChild( frame->node, node );
+		addToken( ctx, node, nt_operator, frame->tagOn, strlen( frame->tagOn ) );
+		addChild( node, underscript );
+	}
+	else
+	{
+		node = newElement( ctx, nt_script, "<mover>", frame->tagOff );
+		addChild( frame->node, node );
+		addToken( ctx, node, nt_operator, frame->tagOn, strlen( frame->tagOn ) );
+	}
+
+	popFrame( ctx );
+
+	return getCommandParam( ctx, node, se_use_default );
+}
+
+// 'quit' is set when the command ends the expression being parsed
+
+// the kind of element a command with parameters makes
+
+static node_type elementType( command_id id )
+{
+	switch( id )
+	{
+	case ci_frac:
+	case ci_mfrac:
+	case ci_cfrac:
+	case ci_binom:
+	case ci_stack:
+		return nt_fraction;
+	case ci_sqrt:
+		return nt_root;
+	case ci_stackrel:
+	case ci_underoverbrace:
+	case ci_lsub:
+	case ci_lsup:
+	case ci_lsubsup:
+		return nt_script;
+	default:
+		return nt_element;
+	}
+}
+
+// a command whose 'count' arguments go to its element in turn;
+// stepCommand() reads them and adds what goes between
+
+static bool readArguments( ConverterContext &ctx, MathNode *row, const CommandStruct *command, int count )
+{
+	ParseFrame *frame = pushCommand( ctx, stepCommand, row );
+
+	frame->id	   = command->id;
+	frame->params  = count;
+	frame->element = newElement( ctx, elementType( command->id ), command->tagOn, command->tagOff );
+	addChild( row, frame->element );
+
+	return true;
+}
+
+static bool stepCommand( ConverterContext &ctx, ParseFrame *frame )
+{
+	static const char display[] = "<mstyle displaystyle='true' scriptlevel='0'>";
+	MathNode *node, *dest;
+	int done;
+
+	node = frame->element;
+	dest = node;
+	done = frame->stage++;
+
+	switch( frame->id )
+	{
+	case ci_stackrel:
+		// the first goes over the second
+		if( done == 0 )
+		{
+			frame->extra = newNode( ctx.arena, nt_list );
+			dest		 = frame->extra;
+		}
+		else if( done == 2 )
+		{
+			addChild( node, frame->extra );
+		}
+		break;
+	case ci_cfrac:
+		// the numerator and the denominator are each in display style
+		if( done < 2 )
+		{
+			dest = newElement( ctx, nt_element, display, "</mstyle>" );
+			addChild( node, dest );
+		}
+		break;
+	case ci_underoverbrace:
+		if( done == 1 )
+		{
+			popFrame( ctx );
+			return onLimits( ctx, node, mt_mov_limits );
+		}
+		break;
+	case ci_lsub:
+		if( done == 1 )
+		{
+			addLiteral( ctx, node, nt_space, "<mprescripts/>" );
+		}
+		else if( done == 2 )
+		{
+			addLiteral( ctx, node, nt_space, "<none/>" );
+		}
+		break;
+	case ci_lsup:
+		if( done == 1 )
+		{
+			addLiteral( ctx, node, nt_space, "<mprescripts/><none/>" );
+		}
+		break;
+	case ci_lsubsup:
+		if( done == 1 )
+		{
+			addLiteral( ctx, node, nt_space, "<mprescripts/>" );
+		}
+		break;
+	default:
+		break;
+	}
+
+	if( done == frame->params )
+	{
+		popFrame( ctx );
+		return true;
+	}
+
+	return getCommandParam( ctx, dest, se_use_default );
+}
+
+// 'quit' is set when the command ends the expression being parsed
+
+static bool onCommand( ConverterContext &ctx, MathNode *row, ControlStruct &control, sub_expression subType, void *paramExtra, bool &quit )
+{
+	const CommandStruct *command;
+	MathNode *node;
+
+	command = control.command;
+
+	switch( command->param )
+	{
+	case pt_plain:
+		switch( command->id )
+		{
+		case ci_mn:
+		case ci_mo:			
+			return onMiMnMo( ctx, row, command->tagOn, command->tagOff, command->id );			
+		case ci_mathop:
+			if( !onMathFont( ctx, row, command->tagOn, command->tagOff, command->id ) )
+			{
+				return false;
+			}
+			return onLimits( ctx, row->last, mt_limits );
+		/*
+		case ci_mathrm:
+		case ci_mathit:
+		case ci_mathbf:
+		case ci_mathbi:
+		
+		case ci_mathord,
+		case ci_func:		
+		*/
+		case ci_mathfont:
+		case ci_mathord:
+		case ci_mathbin:
+		case ci_mathrel:
+			return onMathFont( ctx, row, command->tagOn, command->tagOff, command->id );
+		default:
+			break;
+		}
+		break;
+	case pt_especial:
+		switch( command->id )
+		{
+		//case ci_mi:
+		
+		case ci_sqrt:
+			return onSqrt( ctx, row, command->tagOn, command->tagOff );			
+		case ci_begin:
+				return onBeginEnvironment( ctx, row );
+		case ci_end:
+			quit = true;
+			return onEndEnvironment( ctx, subType, paramExtra );
+		case ci_stackrel:
+		case ci_cfrac:
+		case ci_lsub:
+		case ci_lsup:
+			return readArguments( ctx, row, command, 2 );
+		case ci_underoverbrace:
+			return readArguments( ctx, row, command, 1 );
+		case ci_lsubsup:
+			return readArguments( ctx, row, command, 3 );
+		case ci_hfill:
+			return onHfill( ctx, subType );
+		case ci_strut:
+			addToken( ctx, row, nt_space, command->tagOn, strlen( command->tagOn ) );
+			break;
+		case ci_limits:
+		case ci_nolimits:
+			return error( ctx, control.start, ex_misplaced_limits );			
+		case ci_mathstring:
+			return onTextFont( ctx, row, command->tagOn, command->tagOff, command->id, false );			
+		case ci_text:
+			return onTextFont( ctx, row, command->tagOn, command->tagOff, command->id );
+		case ci_eqno:
+		case ci_leqno:
+			if( subType != se_use_default )
+			{
+				return error( ctx, ctx.pCur, ex_misplaced_eqno );
+			}
+			else if ( ctx.isNumberedFormula )
+			{
+				return error( ctx, ctx.pCur, ex_duplicate_eqno );
+			}
+			ctx.eqNumber = newNode( ctx.arena, nt_list );
+
+			if( !onTextFont( ctx, ctx.eqNumber, command->tagOn, command->tagOff, ci_eqno, false ) )
+			{
+				return false;
+			}
+			if( ctx.eqNumber->count == 0 )
+			{
+				// an empty label would leave the <mlabeledtr> half written
+				return error( ctx, ctx.pCur, ex_missing_parameter );
+			}
+			ctx.isNumberedFormula = true;
+			break;
+		case ci_left:
+		case ci_right:
+			return onFence( ctx, row, command->id, subType, command->tagOn, command->tagOff, quit );
+		case ci_ext_arrows:
+			return onArrows( ctx, row, command->tagOn, command->tagOff );
+		default:
+			break;
+		}
+		break;
+
+	case pt_one:		
+		node = newElement( ctx, elementType( command->id ), command->tagOn, command->tagOff );
+		addChild( row, node );
+
+		return getCommandParam( ctx, node, se_use_default );
+
+	case pt_two:
+		return readArguments( ctx, row, command, 2 );
+
+	case pt_three:
+		break;
+
+	case pt_table:
+		break;
+
+	case pt_none:
+		break;
+
+	case pt_others:
+	default:
+		break;
+	}
+
+	return true; 
+}
+
+// characters in the text of an element: a UTF-8 sequence or a reference
+// such as &amp; is one
+
+static size_t characterCount( const char *s, size_t len )
+{
+	const char *end = s + len;
+	size_t count = 0;
+
+	for( ; s < end; ++s )
+	{
+		if( *s == '&' )
+		{
+			s = (const char *) memchr( s, ';', end - s );
+
+			if( s == NULL )
+			{
+				return count + 1;
+			}
+			++count;
+		}
+		else if( ( *s & 0xC0 ) != 0x80 )
+		{
+			++count;
+		}
+	}
+
+	return count;
+}
+
+static bool onMathFont( ConverterContext &ctx, MathNode *row, const char *tagOn, const char *tagOff, command_id id )
+{
+	InputStream input;
+	ControlStruct control;
+	const SymbolStruct *symbol;
+	Buffer str( &ctx.arena );
+	char *close;
+	bool quitLoop;	
+
+	close = NULL;
+	
+	if( peek( ctx, ctx.pCur ) == '{' )
+	{
+		close	  = getClosingBrace( ctx );
+		quitLoop  = false;	// loop
+
+		if( close == NULL )
+		{
+			return false;
+		}
+	}
+	else
+	{
+		quitLoop = true;	// read only one char
+	}
+	
+
+	while( getInput( ctx, input, sp_skip_all ) )
+	{
+		switch( input.token )
+		{
+		case token_alpha:
+		case token_digit:
+			str.write( *ctx.pCur );
+			++ctx.pCur;
+			break;
+		case token_prime:
+			{
+				const SymbolStruct *sym;
+				char buf[5];
+
+				getPrime( ctx, &ctx.pCur, buf );
+
+				sym = getSymbol( buf, ctx.style );
+				str.write( sym->literal );
+			}
+			break;
+		case token_symbol:
+		case token_control_symbol:
+		case token_right_sq_bracket:			
+			symbol = input.symbol;
+			if( symbol == NULL )
+			{
+				return error( ctx, input.start, ex_unknown_character );
+			}
+			str.write( symbol->literal );
+			break;		
+		
+		case token_white_space:
+			if( ctx.style & STYLE_COMPACT )
+			{
+				str.writeLiteral( "\xC2\xA0" );	// U+00A0 in UTF-8
+			}
+			else
+			{
+				str.writeLiteral( "&#x00A0;" );
+			}
+			if( isSpace( peek( ctx, ctx.pCur ) ) )
+			{
+				skipSpaces( ctx, &ctx.pCur );
+			}
+			break;
+		case token_left_brace:
+			break;
+		case token_right_brace:
+			if( close == NULL )
+			{
+				return error( ctx, input.start, ex_missing_parameter );		
+			}			
+			quitLoop = ( input.start == close );
+			break;
+		case token_inline_math:
+			return error( ctx, input.start, ex_misplaced_inline_formula );
+
+		case token_superscript:
+		case token_subscript:
+			return error( ctx, input.start, ex_no_command_allowed );
+		case token_column_sep:
+			return error( ctx, input.start, ex_misplaced_column_separator );
+		case token_row_sep:		
+			return error( ctx, input.start, ex_misplaced_row_separator );		
+		
+		case token_control_name:
+			
+			switch( getControlTypeEx( ctx, input, control ) )
+			{		
+			case token_control_entity:
+				str.write( control.literal->text, control.literal->len );
+				break;
+			case token_control_function:
+				str.write( control.literal->text, control.literal->len );				
+				break;				
+			case token_control_command:
+				return error( ctx, input.start, ex_no_command_allowed );
+				break;
+			//case token_unknown:
+			default:
+				return error( ctx, input.start, ex_undefined_control_sequence );								
+			}
+			break;
+		default:
+			break;
+		}
+		if( quitLoop )
+		{
+			break;
+		}
+	}
+
+	if( input.token == token_error )
+	{
+		return false;
+	}
+
+	// more than one character in an <mi> is upright anyway
+	if( ( ctx.style & STYLE_COMPACT ) && ( strcmp( tagOn, miNormal ) == 0 ) && ( characterCount( str.data(), str.length() ) > 1 ) )
+	{
+		tagOn = "<mi>";
+	}
+
+	addText( ctx, row, ( id == ci_mn ) ? nt_number : ( id == ci_mathfont ) ? nt_identifier : nt_operator, tagOn, str.data(), str.length(), tagOff );
+
+	return true;
+}
+
+
+// the text and the inline formulas in it go to 'dest' as one element
+
+static bool onTextFont( ConverterContext &ctx, MathNode *dest, const char *tagOn, const char *tagOff, command_id id, bool allowInline )
+{
+	ParseFrame *frame;
+	char *close;
+
+	close = NULL;	
+
+	if( ( id != ci_eqno ) && ( id != ci_leqno ) )
+	{
+		if( peek( ctx, ctx.pCur ) != '{' )
+		{
+			return error( ctx, ctx.pCur, ex_missing_lbrace );
+		}
+	}
+
+	if( peek( ctx, ctx.pCur ) == '{' )
+	{
+		close = getClosingBrace( ctx );
+
+		if( close == NULL )
+		{
+			return false;
+		}
+	}
+
+	// the text is read right away; an inline formula in it is a group,
+	// after which stepText() goes on
+
+	frame = pushCommand( ctx, stepText, dest );
+
+	frame->tagOn	   = tagOn;
+	frame->tagOff	   = tagOff;
+	frame->close	   = close;
+	frame->allowInline = allowInline;
+	frame->element	   = newNode( ctx.arena, nt_row );
+
+	return stepText( ctx, frame );
+}
+
+static bool stepText( ConverterContext &ctx, ParseFrame *frame )
+{
+	InputStream input;
+	ControlStruct control;
+	const SymbolStruct *symbol;
+	Buffer str( &ctx.arena );
+	MathNode *temp;
+	bool quitLoop;
+
+	temp = frame->element;
+
+	if( frame->stage++ != 0 )
+	{
+		// skip end $
+		++ctx.pCur;
+
+		appendRow( temp, frame->extra );
+	}
+
+	quitLoop = false;
+
+	while( getInput( ctx, input, sp_skip_once ) )
+	{
+		switch( input.token )
+		{
+		case token_alpha:
+		case token_digit:
+			str.write( *ctx.pCur );
+			++ctx.pCur;
+			break;
+		
+		case token_symbol:
+		case token_control_symbol:
+		case token_right_sq_bracket:
+			symbol = input.symbol;
+			if( symbol == NULL )
+			{
+				return error( ctx, input.start, ex_unknown_character );
+			}
+			str.write( symbol->literal );
+			break;
+		case token_prime:
+			if( peek( ctx, ctx.pCur, 1 ) == char_prime )
+			{
+				if( ctx.style & STYLE_COMPACT )
+				{
+					str.writeLiteral( "\xE2\x80\x9D" );	// U+201D in UTF-8
+				}
+				else
+				{
+					str.writeLiteral( "&#x201D;" );
+				}
+				ctx.pCur += 2;
+			}
+			else
+			{
+				if( ctx.style & STYLE_COMPACT )
+				{
+					str.writeLiteral( "\xE2\x80\x99" );	// U+2019 in UTF-8
+				}
+				else
+				{
+					str.writeLiteral( "&#x2019;" );
+				}
+				++ctx.pCur;
+			}			
+			break;
+		case token_inline_math:
+			if( !frame->allowInline )
+			{
+				return error( ctx, input.start, ex_misplaced_inline_formula );
+			}
+			if( str.length() > 0 )
+			{
+				addText( ctx, temp, nt_text, frame->tagOn, str.data(), str.length(), frame->tagOff );
+			}
+
+			frame->extra = newNode( ctx.arena, nt_row );
+
+			skipChar( ctx, &ctx.pCur );
+
+			return pushGroup( ctx, frame->extra, se_inline_math, NULL, true ) != NULL;
+
+		case token_white_space:
+			if( ctx.style & STYLE_COMPACT )
+			{
+				str.writeLiteral( "\xC2\xA0" );	// U+00A0 in UTF-8
+			}
+			else
+			{
+				str.writeLiteral( "&#x00A0;" );
+			}
+			if( isSpace( peek( ctx, ctx.pCur ) ) )
+			{
+				skipSpaces( ctx, &ctx.pCur );
+			}
+			break;
+		case token_left_brace:
+			break;
+		case token_right_brace:
+			if( frame->close == NULL )
+			{
+				return error( ctx, input.start, ex_missing_parameter );		
+			}			
+			quitLoop = ( input.start == frame->close );
+			break;
+		case token_superscript:
+		case token_subscript:
+			return error( ctx, input.start, ex_no_command_allowed );
+		case token_column_sep:
+			return error( ctx, input.start, ex_misplaced_column_separator );
+		case token_row_sep:		
+			return error( ctx, input.start, ex_misplaced_row_separator );		
+		
+		case token_control_name:
+			
+			switch( getControlTypeEx( ctx, input, control ) )
+			{		
+			case token_control_entity:
+				str.write( control.literal->text, control.literal->len );
+				break;
+			case token_control_function:
+				return error( ctx, input.start, ex_not_math_mode );
+			case token_control_command:
+				return error( ctx, input.start, ex_no_command_allowed );
+			//case token_unknown:
+			default:
+				return error( ctx, input.start, ex_undefined_control_sequence );								
+			}
+			break;
+		default:
+			break;
+		}
+		if( quitLoop )
+		{
+			break;
+		}
+	}
+
+	if( input.token == token_error )
+	{
+		return false;
+	}
+				
+	if( str.length() )
+	{
+		addText( ctx, temp, nt_text, frame->tagOn, str.data(), str.length(), frame->tagOff );
+	}
+
+	appendRow( frame->node, temp );
+	popFrame( ctx );
+
+	return true;
+}
+
+static bool getFence( ConverterContext &ctx, Buffer &prevBuf, const char *tagOn, command_id id )
+{
+	InputStream input;
+	FenceStruct fence;
+	size_t len;
+
+
+	len = strlen( tagOn );
+
+	getInput( ctx, input, sp_skip_all );
+
+	switch( input.token )
+	{
+	case token_control_symbol:	
+	case token_symbol:	
+	case token_control_name:
+		if( !getFenceType( input.buffer, fence, ctx.style ) )
+		{
+			return error( ctx, input.start, ex_missing_fence_parameter );
+		}
+		
+		if( ctx.style & STYLE_CORE )
+		{
+			// MathML Core has no <mfenced>: the fences are <mo>s around
+			// the <mrow> of the content
+
+			if( id == ci_right )
+			{
+				prevBuf.writeLiteral( "</mrow>" );
+			}
+			else
+			{
+				prevBuf.writeLiteral( "<mrow>" );
+			}
+
+			prevBuf.write( fence.element->text, fence.element->len );
+
+			if( id == ci_right )
+			{
+				prevBuf.writeLiteral( "</mrow>" );
+			}
+			else
+			{
+				prevBuf.writeLiteral( "<mrow>" );
+			}
+		}
+		else if ( id == ci_left )
+		{
+			prevBuf.write( tagOn, len - 1 ); // don't write >
+
+			if( *input.start != '(' )
+			{
+				prevBuf.write( fence.left->text, fence.left->len );
+			}
+		}
+		else
+		{
+			if( *input.start == ')' )
+			{
+				prevBuf.writeLiteral( "><mrow>" );
+			}
+			else
+			{
+				prevBuf.write( fence.right->text, fence.right->len );
+			}
+		}
+		break;
+	case token_error:
+		return false;
+	case token_eof:
+		return error( ctx, ctx.pCur, ex_missing_fence_parameter );
+	default:
+		return error( ctx, input.start, ex_missing_fence_parameter );
+	}
+
+	return true;
+}
+
+static bool onFence( ConverterContext &ctx, MathNode *row, command_id id, sub_expression subType, const char *tagOn, const char *tagOff, bool &quit )
+{
+	Buffer on( &ctx.arena );
+	ParseFrame *frame;
+	MathNode *node;
+
+	if( id == ci_right )
+	{
+		if( subType == se_fence )
+		{
+			quit = true;
+			return true;
+		}
+		return error( ctx, ctx.pCur, ex_missing_left_fence );
+	}
+
+	node = newNode( ctx.arena, nt_fence );
+	addChild( row, node );
+
+	if( !getFence( ctx, on, tagOn, ci_left ) )
+	{
+		return false;
+	}
+
+	node->text = keepText( ctx, on );
+	node->len  = (unsigned int) on.length();
+
+	// the content is a group; stepFence() reads the right fence after it
+
+	frame = pushCommand( ctx, stepFence, row );
+
+	frame->tagOn   = tagOn;
+	frame->tagOff  = tagOff;
+	frame->element = node;
+
+	return pushGroup( ctx, node, se_fence, NULL, true ) != NULL;
+}
+
+static bool stepFence( ConverterContext &ctx, ParseFrame *frame )
+{
+	Buffer on( &ctx.arena ), off( &ctx.arena );
+	MathNode *node = frame->element;
+
+	if( ctx.style & STYLE_CORE )
+	{
+		// the right fence goes after the content
+		if( !getFence( ctx, off, frame->tagOn, ci_right ) )
+		{
+			return false;
+		}
+	}
+	else
+	{
+		// both fences are attributes of the start tag
+		on.write( node->text, node->len );
+
+		if( !getFence( ctx, on, frame->tagOn, ci_right ) )
+		{
+			return false;
+		}
+
+		node->text = keepText( ctx, on );
+		node->len  = (unsigned int) on.length();
+		off.write( frame->tagOff );
+	}
+
+	node->textOff = keepText( ctx, off );
+	node->lenOff  = (unsigned int) off.length();
+	popFrame( ctx );
+
+	return true;
+}
+
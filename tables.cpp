@@ -1,684 +1,1571 @@
-/*
-//  Copyright (c) 2020 Peter Frane Jr. All Rights Reserved.
-//
-//  Use of this source code is governed by the GPL v. 3.0 license that can be
-//  found in the LICENSE file.
-//
-//  This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
-//  OF ANY KIND, either express or implied.
-//
-//  For inquiries, email the author at pfranejr AT hotmail.com
-*/
-
-#include "tables.h"
-#include <stdio.h>
-	
-static CommandStruct commandTable[] = {
-{"Overleftarrow",			ci_accent,pt_one, "<mover accent='true'>", "<mo stretchy='true'>&#x21D0;</mo></mover>" },
-{"Overleftrightarrow",		ci_accent,pt_one, "<mover accent='true'>", "<mo stretchy='true'>&#x21D4;</mo></mover>" },
-{"Overrightarrow",			ci_accent,pt_one, "<mover accent='true'>", "<mo stretchy='true'>&#x21D2;</mo></mover>" },
-{"actuarial",				ci_menclose,    pt_one,"<menclose notation='actuarial'>",  "</menclose>" },
-{"acute",					ci_accent,pt_one, "<mover accent='true'>", "<mo>&#x00B4;</mo></mover>" },
-{"bar",						ci_accent,pt_one, "<mover accent='true'>", "<mo stretchy='false'>&#x00AF;</mo></mover>" },
-{"begin",					ci_begin,pt_especial,"", "" },
-{"binom",					ci_binom,pt_two, "<mfenced><mrow><mfrac linethickness='0'>","</mfrac></mrow></mfenced>" },
-{"breve",					ci_accent,pt_one, "<mover accent='true'>", "<mo>&#x02D8;</mo></mover>" },
-{"cfrac",					ci_cfrac,pt_especial,    "<mfrac>", "</mstyle></mfrac>" },
-{"check",					ci_accent,pt_one, "<mover accent='true'>", "<mo>&#x02C7;</mo></mover>" },
-{"ddddot",					ci_accent,pt_one, "<mover accent='true'>", "<mo>&#x00A8;&#x00A8;</mo></mover>" },
-{"dddot",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x20DB;</mo></mover>" },
-{"ddot",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x00A8;</mo></mover>" },
-{"dfrac",	ci_mfrac,	pt_two,	"<mstyle displaystyle='true' scriptlevel='0'><mfrac>", "</mfrac></mstyle>" },
-{"dot",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x02D9;</mo></mover>" },
-{"end",	ci_end,	pt_especial,	"","" },
-{"eqno",	ci_eqno,	pt_especial,	"<mtable><mlabeledtr><mtd><mtext>", "</mtext></mtd><mtd>" },
-{"frac",	ci_frac,	pt_two,	"<mfrac>", "</mfrac>" },
-{"func",	ci_func,	pt_plain,	"<mi>", "</mi>" },
-{"grave",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x0300;</mo></mover>" },
-{"hat",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x02c6;</mo></mover>" },
-{"hfill",	ci_hfill,	pt_especial,	"","" },
-{"hphantom",	ci_phantom,	pt_one,	"<mphantom><mpadded height='0%' depth='0'>", "</mpadded></mphantom>" },
-{"hungarumlaut",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x02DD;</mo></mover>" },
-{"left",	ci_left,	pt_especial,	"<mfenced>", "</mrow></mfenced>" },
-{"leqno",	ci_eqno,	pt_especial,	"<mtable side='left'><mlabeledtr><mtd><mtext>", "</mtext></mtd><mtd>" },
-{"limits",	ci_limits,	pt_especial,	"","" },
-{"longdiv",	ci_menclose,	pt_one,	"<menclose notation='longdiv'>", "</menclose>" },
-{"lsub",	ci_lsub,	pt_especial,	"<mmultiscripts>", "</mmultiscripts>" },
-{"lsubsup",	ci_lsubsup,	pt_especial,	"<mmultiscripts>", "</mmultiscripts>" },
-{"lsup",	ci_lsup,	pt_especial,	"<mmultiscripts>", "</mmultiscripts>" },
-{"mathbb",	ci_mathfont,	pt_plain,	"<mi mathvariant='double-struck'>", "</mi>" },
-{"mathbf",	ci_mathfont,	pt_plain,	"<mi mathvariant='bold'>", "</mi>" },
-{"mathbfrak",	ci_mathfont,	pt_plain,	"<mi mathvariant='bold-fraktur'>", "</mi>" },
-{"mathbi",	ci_mathfont,	pt_plain,	"<mi mathvariant='bold-italic'>", "</mi>" },
-{"mathbin",	ci_mathbin,	pt_plain,	"<mo lspace='.222222em' rspace='.222222em'>", "</mo>" },
-{"mathbsc",	ci_mathfont,	pt_plain,	"<mi mathvariant='bold-script'>", "</mi>" },
-{"mathbss",	ci_mathfont,	pt_plain,	"<mi mathvariant='bold-sans-serif'>", "</mi>" },
-{"mathfrak",	ci_mathfont,	pt_plain,	"<mi mathvariant='fraktur'>", "</mi>" },
-{"mathit",	ci_mathfont,	pt_plain,	"<mi mathvariant='italic'>", "</mi>" },
-{"mathop",	ci_mathop,	pt_plain,	"<mo>", "</mo>" },
-{"mathord",	ci_mathord,	pt_plain,	"<mo lspace='0' rspace='0'>", "</mo>" },
-{"mathord",	ci_mathord,	pt_plain,	"<mo lspace='0' rspace='0'>", "</mo>"},
-{"mathrel",	ci_mathrel,	pt_plain,	"<mo lspace='.27777em' rspace='.27777em'>", "</mo>" },
-{"mathring",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x02DA;</mo></mover>" },
-{"mathrm",	ci_mathfont,	pt_plain,	"<mi mathvariant='normal'>", "</mi>" },
-{"mathsc",	ci_mathfont,	pt_plain,	"<mi mathvariant='script'>", "</mi>" },
-{"mathss",	ci_mathfont,	pt_plain,	"<mi mathvariant='sans-serif'>", "</mi>" },
-{"mathssbi",	ci_mathfont,	pt_plain,	"<mi mathvariant='sans-serif-bold-italic'>", "</mi>" },
-{"mathssi",	ci_mathfont,	pt_plain,	"<mi mathvariant='sans-serif-italic'>", "</mi>" },
-{"mathstrut",	ci_strut,	pt_especial,	"<mphantom><mpadded width='0%' lspace='0'><mo>(</mo></mpadded></mphantom>","" },
-{"mathtt",	ci_mathfont,	pt_plain,	"<mi mathvariant='monospace'>", "</mi>" },
-{"mn",	ci_mn,	pt_plain,	"<mn>", "</mn>" },
-{"mo",	ci_mo,	pt_plain,	"<mo>", "</mo>" },
-{"ms",	ci_mathstring,	pt_especial,	"<ms>", "</ms>" },
-{"nolimits",	ci_limits,	pt_especial,	"","" },
-{"overbrace",	ci_underoverbrace,	pt_especial,	"<mover accent='false'>", "<mo stretchy='true'>&#xFE37;</mo></mover>" },
-{"overbrack",	ci_accent,	pt_one,	"<mover accent='false'>", "<mo stretchy='true'>&#x23B4;</mo></mover>" },
-{"overleftarrow",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo stretchy='true'>&#x2190;</mo></mover>" },
-{"overleftrightarrow",	ci_accent,	pt_one,  	"<mover accent='true'>", "<mo stretchy='true'>&#x2194;</mo></mover>" },
-{"overline",	ci_accent,	pt_one,	"<mover accent='false'>", "<mo stretchy='true'>&#x00AF;</mo></mover>" },
-{"overparen",	ci_accent,	pt_one,	"<mover accent='false'>", "<mo stretchy='true'>&#x2322;</mo></mover>" },
-{"overrightarrow",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo stretchy='true'>&#x2192;</mo></mover>" },
-{"phantom",	ci_phantom,	pt_one,	"<mphantom>", "</mphantom>" },
-{"qdot",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x00A8;&#x00A8;</mo></mover>" },
-{"right",	ci_right,	pt_especial,	"","" },
-{"sqrt",	ci_sqrt,	pt_especial,	"<msqrt>", "</msqrt>" },
-{"stack",	ci_stack,	pt_two,	"<mfrac linethickness='0'>", "</mfrac>" },
-{"stackrel",	ci_stackrel,	pt_especial,	"<mover>", "</mover>" },
-{"strut",	ci_strut,	pt_especial,	"<mspace width='0pt' height='8.5pt' depth='3.5pt'/>","" },
-{"tbinom",	ci_binom,	pt_two,	"<mstyle scriptlevel='1'><mfenced><mrow><mfrac linethickness='0'>", "</mfrac></mrow></mfenced></mstyle>" },
-{"tdot",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x20DB;</mo></mover>" },
-{"text",	ci_text,	pt_especial,	"<mtext>", "</mtext>" },
-{"textbf",	ci_text,	pt_especial,	"<mtext mathvariant='bold'>", "</mtext>" },
-{"textbi",	ci_text,	pt_especial,	"<mtext mathvariant='bold-italic'>", "</mtext>" },
-{"textbsf",	ci_text,	pt_especial,	"<mtext mathvariant='bold-sans-serif'>", "</mtext>" },
-{"textit",	ci_text,	pt_especial,	"<mtext mathvariant='italic'>", "</mtext>" },
-{"textsf",	ci_text,	pt_especial,	"<mtext mathvariant='sans-serif'>", "</mtext>" },
-{"textsfbi",	ci_text,	pt_especial,	"<mtext mathvariant='sans-serif-bold-italic'>", "</mtext>" },
-{"textsfit",	ci_text,	pt_especial,	"<mtext mathvariant='sans-serif-italic'>", "</mtext>" },
-{"texttt",	ci_text,	pt_especial,	"<mtext mathvariant='monospace'>", "</mtext>" },
-{"tfrac",	ci_mfrac,	pt_two,	"<mstyle displaystyle='false' scriptlevel='0'><mfrac>", "</mfrac></mstyle>" },
-{"tilde",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo stretchy='false'>&#x02DC;</mo></mover>" },
-{"underbrace",	ci_underoverbrace,	pt_especial,	"<munder accentunder='false'>", "<mo stretchy='true'>&#xFE38;</mo></munder>" },
-{"underbrack",	ci_accent,	pt_one,	"<munder accentunder='false'>", "<mo stretchy='true'>&#x23B5;</mo></munder>" },
-{"underleftarrow",	ci_accent,	pt_one,	"<munder accentunder='true'>", "<mo stretchy='true'>&#x2190;</mo></munder>" },
-{"underleftrightarrow",	ci_accent,	pt_one,	"<munder accentunder='true'>", "<mo stretchy='true'>&#x2194;</mo></munder>" },
-{"underline",	ci_accent,	pt_one,	"<munder accentunder='false'>", "<mo stretchy='true'>&#x0332;</mo></munder>" },
-{"underparen",	ci_accent,	pt_one,	"<munder accentunder='false'>", "<mo stretchy='true'>&#xF611;</mo></munder>" },
-{"underrightarrow",	ci_accent,	pt_one,	"<munder accentunder='true'>", "<mo stretchy='true'>&#x2192;</mo></munder>" },
-{"undertilde",	ci_accent,	pt_one,	"<munder accentunder='false'>", "<mo stretchy='true'>&#x02DC;</mo></munder>" },
-{"vec",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo stretchy='false'>&#x2192;</mo></mover>" },
-{"vphantom",	ci_phantom,	pt_one,	"<mphantom><mpadded width='0%' lspace='0'>", "</mpadded></mphantom>" },
-{"widehat",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo stretchy='true'>&#x0302;</mo></mover>" },
-{"widetilde",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo stretchy='true'>&#x02DC;</mo></mover>" },
-{"widevec",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo stretchy='true'>&#x2192;</mo></mover>" },
-{"xleftarrow",	ci_ext_arrows,	pt_especial,	"<mo stretchy='true'>&#x2190;</mo>", "</mover>" },
-{"xleftrightarrow",	ci_ext_arrows,	pt_especial,	"<mo stretchy='true'>&#x2194;</mo>", "</mover>"},
-{"xrightarrow",	ci_ext_arrows,	pt_especial,	"<mo stretchy='true'>&#x2192;</mo>", "</mover>" }
-};
-
-struct EnvironmentStruct environmentTable[] = {
-	{ "array",	  ci_array,	   "<mtable><mtr><mtd>", "</mtd></mtr></mtable>" },
-	{ "bmatrix",  ci_bmatrix,   "<mfenced open='[' close=']' separators=''><mtable><mtr><mtd>", "</mtd></mtr></mtable></mfenced>" },
-	{ "cases",    ci_cases,     "<mfenced open='{' close='' separators=''><mtable><mtr><mtd>", "</mtd></mtr></mtable></mfenced>" },
-	{ "eqnarray", ci_eqnarray, "<mtable columnalign='right center left' columnspacing='.222222em'><mtr><mtd>", "</mtd></mtr></mtable>" },
-	{ "matrix",	  ci_matrix,   "<mtable><mtr><mtd>", "</mtd></mtr></mtable>" },
-	{ "pmatrix",  ci_pmatrix,   "<mfenced separators=''><mtable><mtr><mtd>", "</mtd></mtr></mtable></mfenced>" },
-	{ "vmatrix",  ci_vmatrix,   "<mfenced open='|' close='|' separators=''><mtable><mtr><mtd>", "</mtd></mtr></mtable></mfenced>" },
-	{ "Bmatrix",  ci_Bmatrix,   "<mfenced open='{' close='}' separators=''><mtable><mtr><mtd>", "</mtd></mtr></mtable></mfenced>" },	
-	{ "Vmatrix",  ci_Vmatrix,   "<mfenced open='&#x2016;' close='&#x2016;' separators=''><mtable><mtr><mtd>", "</mtd></mtr></mtable></mfenced>" }
-	
-};
-
-static FunctionStruct functionTable[] = {
-	{ "Pr",			"Pr",  				  mt_func_limits},
-	{ "arccos",		"arccos", 			  mt_func},
-	{ "arcsin",		"arcsin",  			  mt_func},
-	{ "arctan",		"arctan", 			  mt_func},
-	{ "arg",		"arg",    			  mt_func},
-	{ "cos",		"cos",    			  mt_func},
-	{ "cosh",		"cosh",   			  mt_func},
-	{ "cot",		"cot",    			  mt_func},
-	{ "coth",		"coth",   			  mt_func},
-	{ "csc",		"csc",    			  mt_func},
-	{ "deg",		"deg",    			  mt_func},
-	{ "det",		"det",  			  mt_func_limits},
-	{ "dim",		"dim",    			  mt_func},
-	{ "exp",		"exp",    			  mt_func},
-	{ "gcd",		"gcd",  			  mt_func_limits},
-	{ "hom",		"hom",    			  mt_func},
-	{ "inf",		"inf",  			  mt_func_limits},
-	{ "ker",		"ker",    			  mt_func},
-	{ "lg",			"lg",     			  mt_func},
-	{ "lim",		"lim",  			  mt_func_limits},
-	{ "liminf",		"lim&#x2009;sup",	  mt_func_limits},		
-	{ "limsup",		"lim&#x2009;sup",	  mt_func_limits},		
-	{ "ln",			"ln",     			  mt_func},
-	{ "log",		"log",    			  mt_func},
-	{ "max",		"max",  			  mt_func_limits},
-	{ "min",		"min",  			  mt_func_limits},	
-	{ "sec",		"sec",    			  mt_func},
-	{ "sin",		"sin",     			  mt_func},
-	{ "sinh",		"sinh",   			  mt_func},
-	{ "sup",		"sup",  			  mt_func_limits},
-	{ "tan",		"tan",    			  mt_func},
-	{ "tanh",		"tanh",   			  mt_func}
-};
-
-
-static EntityStruct entityTable[] = {
-
-{ "Delta",  	0x394, mt_ident }, 
-{ "Gamma",  	0x393, mt_ident }, 
-{ "Lambda",  0x39B, mt_ident }, 
-{ "Omega",  0x3A9, mt_ident }, 
-{ "Phi",  0x3A6, mt_ident }, 
-{ "Psi",  0x3A8, mt_ident }, 
-{ "Sigma",  0x3A3, mt_ident }, 
-{ "Xi",  0x39E, mt_ident }, 
-{ "alpha",		0x3B1,	mt_ident },
-{ "ast",  		0x2A, mt_bin }, 
-{ "beta",		0x3B2,	mt_ident  },
-{ "bigcap",		0x22C2, mt_mov_limits  },
-
-{ "bigcup",		0x22C3, mt_mov_limits  },
-
-{ "bigodot",	0x2299,	mt_mov_limits  },
-
-{ "bigoplus",	0x2295,	mt_mov_limits  },
-
-{ "bigotimes",	0x2297,	mt_mov_limits  },
-
-{ "bigsqcup",	0x2A06,	mt_mov_limits  },
-
-{ "biguplus",	0x2A04,	mt_mov_limits  },
-
-{ "bigvee",		0x22C1,	mt_mov_limits  },
-
-{ "bigwedge",	0x22C0,	mt_mov_limits  },
-
-{ "cdot",  		0xB7, mt_bin }, 
-{ "cdots",  	0x22EF, mt_ord }, 
-{ "centerdot",  0xB7, mt_bin }, 
-{ "chi",  		0x3C7, mt_ident }, 
-{ "coprod",		0x2210, mt_mov_limits  },
-
-{ "ddots",  	0x22F1, mt_ord }, 
-{ "delta",  	0x3B4, mt_ident }, 
-{ "div",  		0xF7, mt_bin }, 
-{ "epsilon",  	0x3B5, mt_ident }, 
-{ "gamma",  	0x3B3, mt_ident }, 
-{ "ge",  		0x2265, mt_rel }, 
-{ "iiiint",		0x2A0C,	mt_limits   },
-
-{ "iiint",		0x222D,	mt_limits   },
-
-{ "iint",		0x222C,	mt_limits   },
-
-{ "infinity",  0x221E, mt_rel }, 
-{ "int",		0x222B,	mt_limits   },
-
-{ "kappa",  0x3BA, mt_ident }, 
-{ "lambda",  0x3BB, mt_ident }, 
-{ "ldots",  0x2026, mt_ord }, 
-{ "le",  0x2264, mt_rel }, 
-{ "leftarrow",  0x2190, mt_rel }, 
-
-
-
-{ "mu",  0x3BC, mt_ident }, 
-
-{ "nabla",  0x2207, mt_ident }, 
-{ "nu",  0x3BD, mt_ident }, 
-{ "oint",		0x222E,	mt_limits   },
-
-
-{ "omega",  0x3C9, mt_ident }, 
-{ "partial",  0x2202, mt_ord }, 
-{ "phi",  0x3C6, mt_ident }, 
-{ "pi",  0x3C0, mt_ident }, 
-{ "pm",  0xB1, mt_rel }, 
-
-{ "prod",		0x220f,	mt_mov_limits  },
-{ "psi",  0x3C8, mt_ident }, 
-
-{ "rho",  0x3C1, mt_ident }, 
-{ "rightarrow",  0x2192, mt_rel }, 
-{ "sigma",  0x3C3, mt_ident }, 
-{ "sim",  0x223C, mt_rel }, 
-{ "sum",		0x2211,	mt_mov_limits  },
-
-{ "tau",  0x3C4, mt_ident }, 
-{ "theta",  0x3B8, mt_ident }, 
-{ "times",  0xD7, mt_bin }, 
-{ "to",  0x2192, mt_rel }, 
-{ "upsilon",  0x3C5, mt_ident },
-{ "varepsilon",  0x3B5, mt_ident },
-{ "vdots",  0x22EE, mt_ord }, 
-{ "xi",  0x3BE, mt_ident },
-{ "zeta",  0x3B6, mt_ident } 
-
-
-};
-
-static ErrorTable errorTable[] = {
-	{ ex_out_of_memory,							"Out of memory" },
-	{ ex_missing_lbrace,						"Missing '{'" },
-	{ ex_prefix_superscript,					"Illegal prefix superscript: use the '\\lsup' command" },
-	{ ex_prefix_subscript,						"Illegal prefix subscript: use the '\\lsub' command" },
-	{ ex_misplaced_column_separator,			"Misplaced column separator" },		
-	{ ex_more_rbrace_than_lbrace,				"Syntax error: more '}' than '{'" },
-	{ ex_control_name_too_long,					"Control name too long: maximum is 32" },
-	{ ex_misplaced_row_separator,				"Misplaced row separator" },
-	{ ex_illegal_subscript,						"Illegal subscript" },
-	{ ex_illegal_superscript,					"Illegal superscript" },
-	{ ex_undefined_control_sequence,			"Undefined control sequence" },
-	{ ex_misplaced_inline_formula,				"Misplaced inline formula" },
-	{ ex_missing_parameter,						"Missing parameter" },
-	{ ex_more_lbrace_than_rbrace,				"Syntax error: more '{' than '}'" },	
-	{ ex_double_superscript,					"Double superscript" },
-	{ ex_double_subscript,						"Double subscript" },
-	{ ex_use_subscript_before_superscript,      "Use subscript first as the element is <msubsup>" },
-	{ ex_internal_error,						"Internal error" },
-	{ ex_missing_end_tag,						"Missing end tag" },
-	{ ex_undefined_environment_type,			"Undefined environment type" },
-	{ ex_unknown_alignment_character,			"Unknown alignment character" },
-	{ ex_missing_begin,							"Missing \\begin" },
-	{ ex_missing_end,							"Missing \\end" },
-	{ ex_mismatched_environment_type,           "Mismatched environment type"},
-	{ ex_too_many_columns,						"Too many columns" },
-	{ ex_unknown_attribute,						"Unknown attribute" },
-	{ ex_no_command_allowed,					"Command not allowed here" },
-	{ ex_misplaced_limits,						"Limit controls must follow a math operator" },
-	{ ex_missing_fence_parameter,				"Missing fence parameter" },
-	{ ex_not_math_mode,							"Not in math mode" },
-	{ ex_missing_right_sq_bracket,				"Missing ']'" },
-	{ ex_missing_dollar_symbol,					"Missing '$'" },
-	{ ex_missing_left_fence,					"Missing \\left" },
-	{ ex_missing_right_fence,					"Missing \\right" },
-	{ ex_ambiguous_script,						"Ambiguous script; use \\left and \\right" },
-	{ ex_misplaced_eqno,						"Equation number not allowed here" },
-	{ ex_duplicate_eqno,						"Duplicate equation number" },
-	{ ex_missing_column_alignment,				"Missing column alignment" },
-	{ ex_missing_subsup_base,					"Missing subscript/superscript base" },
-	{ ex_unknown_character,						"Internal error: Unknown character" },
-	{ ex_unhandled_mathtype,					"Internal error: unhandled math type" }
-	//{ ex_misplaced_nolimits,					"Nolimits control must follow a math operator" }
-};
-
-SymbolTable mathvariant[]= {	
-	{"bb",		"double-struck"},		
-	{"bf",		"bold"},		
-	{"bfrak",	"bold-fraktur"},		
-	{"bi",		"bold-italic"},		
-	{"bsc",		"bold-script"},		
-	{"bss",		"bold-sans-serif"},		
-	{"frak",	"fraktur"},		
-	{"it",		"italic"},		
-	{"rm",		"normal"}, 		
-	{"sc",		"script"},		
-	{"ss",		"sans-serif"},		
-	{"ssbi",	"sans-serif-bold-italic"},		
-	{"ssi",		"sans-serif-italic"},		
-	{"tt",		"monospace"}
-};
-
-static EntityStruct fenceTable[] = {
-
-	{ "[",      	    '[',		mt_left_fence },
-    { "]",      	    ']',		mt_right_fence },
-    { "\\{",      	    '{',		mt_left_fence },
-    { "\\}",      	    '}',		mt_right_fence },
-    { "/",      	    '/',		mt_ord },
-    { "(",      	    '(',		mt_left_fence },
-    { ")",      	    ')',		mt_right_fence },
-    { "|",				0x007C,		mt_ord },
-    { "\\|",			0x2016,		mt_ord },
-    { "<",				0x2329,		mt_left_fence },
-    { ">",				0x232A,		mt_right_fence },
-    { ".",				0,			mt_ord },  //see function below
-    { "lgroup",      	'(',		mt_left_fence },
-    { "rgroup",      	')',		mt_right_fence },
-   	{ "langle",			0x2329,		mt_left_fence },
-    { "rangle",			0x232A,		mt_right_fence },
-    { "lAngle",			0x300A,		mt_left_fence },
-    { "rAngle",			0x300B,		mt_right_fence },
-    { "lfloor",			0x230A,		mt_left_fence },//'&lfloor}, //0x230A},
-    { "rfloor",			0x230B,		mt_right_fence },//'&rfloor}, //0x230B},
-    { "lceil",			0x2308,		mt_left_fence },//'&lceil},  // 0x2308},
-    { "rceil",			0x2309,		mt_right_fence },//'&rceil}, // 0x2309},
-    { "lbrack",			'[',		mt_left_fence },
-    { "rbrack",			']',		mt_right_fence },
-    { "lBrack",			0x301A,		mt_left_fence },
-    { "rBrack",			0x301B,		mt_right_fence },
-    { "lbrace",			'{',		mt_left_fence },
-    { "rbrace",			'}',		mt_right_fence },
-    { "backslash",		'\\',		mt_ord },
-    { "vert",			0x007C,		mt_ord },
-    { "Vert",			0x2016,		mt_ord },
-    { "uparrow",		0x2191,		mt_ord },
-    { "Uparrow",		0x21D1,		mt_ord },
-    { "downarrow",		0x2193,		mt_ord },
-    { "Downarrow",		0x21D3,		mt_ord },
-    { "updownarrow",	0x2195,		mt_ord },
-    { "Updownarrow",	0x21D5,		mt_ord },
-    { "lmoustache",		0x23B0,		mt_left_fence }, //0x23B0},
-    { "rmoustache",		0x23B1,		mt_right_fence }, //0x23B1},
-    { "lmoust",  	    0x23B0,		mt_left_fence },
-    { "rmoust",			0x23B1,		mt_right_fence }
-};
-
-// thickspace .27777 
-// medspace	  .222222em
-// thinspace	.16667em
-static SymbolStruct symbols[]= {
-	{"\\ ",		"&#x00a0;",  	"<mspace width='.25em'/>", 			mt_ord },
-	{"\\,",		"&#x2006;",  	"<mspace width='.16667em'/>", 		mt_ord },
-	{"\\:",		"&#x205f;",  	"<mspace width='.222222em'/>", 		mt_ord },
-	{"\\>",		"&#x205f;",  	"<mspace width='.222222em'/>", 		mt_ord },
-	{"\\;",		"&#x2005;",  	"<mspace width='.27777em'/>", 		mt_ord },
-	{"\\!",		"&#x200a;",  	"<mspace width='-.16667em'/>",  	mt_ord },
-	{"\\~",		"&#x00a0;",  	"<mo>&#x00A0;</mo>",  				mt_ord },
-	{"\\|",		"&#x2016;", 	"<mo mathsize='1'>&#x2016;</mo>", 	mt_fence },
-	{"\\{",		"{",	   		"<mo mathsize='1'>{</mo>", 	        mt_left_fence },
-	{"\\}",		"}",	   		"<mo mathsize='1'>}</mo>", 	        mt_right_fence },
-	//{"|",		"|",	   		"<mo mathsize='1'>&#x0007C;</mo>", 	mt_ord },
-	{"|",		"|",	   		"<mo mathsize='1'>|</mo>", 			mt_ord },
-	{"[",		"[",  	   		"<mo mathsize='1'>[</mo>", 			mt_left_fence },
-	{"]",		"]",  	   		"<mo mathsize='1'>]</mo>", 			mt_right_fence },
-	{"(",		"(",  	   		"<mo mathsize='1'>(</mo>", 			mt_left_fence },
-	{")",		")",  	   		"<mo mathsize='1'>)</mo>", 			mt_right_fence },
-	{"<",		"<",  	   		"<mo mathsize='1'>&lt;</mo>", 		mt_left_fence },
-	{">",		">",  	   		"<mo mathsize='1'>&gt;</mo>", 		mt_right_fence },
-	{"-",		"-",			"<mo>&#x2212;</mo>", 				mt_bin_unary },
-	{"`",		"&#x0300;",		"<mo>&#x0300;</mo>", 				mt_ord },
-	{"@",		"&#x0040;",		"<mo>&#x0040;</mo>",            	mt_ord },
-	{"*",		"*",			"<mo>*</mo>",                   	mt_ord },
-	{"'",		"&#x02032;",	"<mo>&#x02032;</mo>",           	mt_ord },
-	{"''",		"&#x02033;",	"<mo>&#x02033;</mo>",           	mt_ord },
-	{"'''",		"&#x02034;",	"<mo>&#x02034;</mo>",           	mt_ord },
-	{"\"",		"&#x0201D;",	"<mo>&#x0201D;</mo>",           	mt_ord },
-	{"/",		"/",			"<mtext>/</mtext>",             	mt_ord },
-	{"\\/",		"&#x200b;",		"<mo>&#x200b;</mo>",            	mt_ord },	
-	{"\\%",		"%",			"<mo>%</mo>", 						mt_ord },
-	{"\\#",		"&#x00023;",	"<mo>&#x00023;</mo>", 				mt_ord },
-	{"\\$",		"$",			"<mtext>$</mtext>", 				mt_ord },
-	{"\\^",		"&#x02C6;",		"<mo>&#x02C6;</mo>", 				mt_ord },
-	{"\\&",		"&amp;",		"<mo>&amp;</mo>", 					mt_ord },
-	{"\\_",		"&#x0005F;",	"<mo>&#x0005F;</mo>", 				mt_ord },
-	{"\\-",		"&#x200b;",		"<mo>&#x200b;</mo>", 				mt_ord },
-	{"!",		"!",			"<mo>!</mo>",   					mt_ord },
-	{"+",		"+",			"<mo>+</mo>",						mt_bin_unary },
-	{"=",		"=",			"<mo>=</mo>",						mt_bin },
-	{":",		":",			"<mo>:</mo>",						mt_bin },
-	{";",		";",			"<mo>;</mo>",						mt_ord },
-	{",",		",",			"<mo>,</mo>",						mt_punct },
-	{".",		".",			"<mo>.</mo>",						mt_ord },
-	{"?",		"?",			"<mo>?</mo>",						mt_ord }
-};
-
-#define TABLE_SIZE(x)  ( sizeof( (x) )/sizeof( (x)[0] ))
-
-
-inline int fastCompare( const char *s1, const char *s2 )
-{
-	return ( ( *s1 == *s2 ) ? strcmp( s1, s2 ) : *s1 - *s2 );
-}
-
-
-CommandStruct *isCommand( const char *name )
-{
-	const int size = TABLE_SIZE( commandTable );
-
-	int result, low, mid, high;
-
-	low = 0;
-	high = size - 1;
-
-	while( low <= high )
-	{
-		mid = ( low + high )/2;
-
-		result = fastCompare( name, commandTable[mid].name );
-
-		if( result < 0 )
-		{
-			high = mid - 1;
-		}
-		else if( result > 0 )
-		{
-			low = mid + 1;
-		}
-		else
-		{
-			return &commandTable[mid];			
-		}
-	}
-
-	return NULL;
-}
-
-
-EntityStruct *isEntity( const char *name )
-{
-	const int size = TABLE_SIZE( entityTable );
-
-	int result, low, mid, high;
-
-	low = 0;
-	high = size - 1;
-
-	while( low <= high )
-	{
-		mid = ( low + high )/2;
-
-		result = fastCompare( name, entityTable[mid].name );
-
-		if( result < 0 )
-		{
-			high = mid - 1;
-		}
-		else if( result > 0 )
-		{
-			low = mid + 1;
-		}
-		else
-		{
-			return &entityTable[mid];			
-		}
-	}
-
-	return NULL;
-
-}
-
-
-FunctionStruct *isFunction( const char *name )
-{
-	const int size = TABLE_SIZE( functionTable );
-
-	int result, low, mid, high;
-
-	low = 0;
-	high = size - 1;
-
-	while( low <= high )
-	{
-		mid = ( low + high )/2;
-
-		result = fastCompare( name, functionTable[mid].name );
-
-		if( result < 0 )
-		{
-			high = mid - 1;
-		}
-		else if( result > 0 )
-		{
-			low = mid + 1;
-		}
-		else
-		{
-			return &functionTable[mid];			
-		}
-	}
-
-	return NULL;
-}
-
-token_type getControlType( const char *name, ControlStruct &control )
-{
-	
-	if( ( control.command = isCommand( name ) ) != NULL )
-	{
-		control.token = token_control_command;		
-	}
-	else if( ( control.entity = isEntity( name ) ) != NULL )
-	{
-		control.token = token_control_entity;
-	}
-	else if( ( control.function = isFunction( name ) ) != NULL )
-	{
-		control.token = token_control_function;
-	}	
-	else
-	{
-		control.token = token_unknown;
-	}
-
-	return control.token;
-}
-
-/*
-
-enum math_type { mt_unknown, mt_ident, mt_digit, mt_ord, mt_bin, mt_unary, mt_rel, mt_fence, 
-				 mt_mov_limits, mt_limits, mt_func, mt_func_limits, mt_text };
-*/
-
-const char *getErrorMsg( ex_exception code )
-{
-	const int size = TABLE_SIZE( errorTable );
-
-	for( int i = 0; i < size; ++i )
-	{
-		if( code == errorTable[i].code )
-		{
-			return errorTable[i].msg;
-		}
-	}	
-
-	return NULL;
-}
-
-const char *getMathVariant( const char *attrib )
-{
-	const int size = TABLE_SIZE( mathvariant );
-
-	int result, low, mid, high;
-
-	low = 0;
-	high = size - 1;
-
-	while( low <= high )
-	{
-		mid = ( low + high )/2;
-
-		result = fastCompare( attrib, mathvariant[mid].key );
-
-		if( result < 0 )
-		{
-			high = mid - 1;
-		}
-		else if( result > 0 )
-		{
-			low = mid + 1;
-		}
-		else
-		{
-			return mathvariant[mid].value;			
-		}
-	}
-
-	return NULL;
-}
-
-
-bool getFenceType( const char *name,  FenceStruct &fence )
-{
-	const int size = TABLE_SIZE( fenceTable );
-
-	for( int i = 0; i < size; ++i )
-	{
-		if( strcmp( name, fenceTable[i].name ) == 0 )
-		{
-			fence.entity   = &fenceTable[i];
-			
-
-			if( fence.entity->code < 256 ) // ascii
-			{
-				fence.output[0] = (char)fence.entity->code;
-				fence.output[1] = '\0';
-			}
-			else
-			{				
-				sprintf_s( fence.output, sizeof( fence.output ) - 1, "&#x%x;", fence.entity->code );
-				//sprintf( fence.output, "&#x%x;", fence.entity->code );
-			}
-			return true;		
-		}
-	}
-
-	fence.entity = NULL;
-	return false;
-}
-
-
-
-EnvironmentStruct *getEnvironmentType( const char *name )
-{
-	const int size = TABLE_SIZE( environmentTable );
-	
-	int result, low, mid, high;
-
-	low = 0;
-	high = size - 1;
-
-	while( low <= high )
-	{
-		mid = ( low + high )/2;
-
-		result = fastCompare( name, environmentTable[mid].name );
-
-		if( result < 0 )
-		{
-			high = mid - 1;
-		}
-		else if( result > 0 )
-		{
-			low = mid + 1;
-		}
-		else
-		{
-			return &environmentTable[mid];			
-		}
-	}
-
-
-	return NULL;
-}
-
-
-SymbolStruct *getSymbol( const char *name )
-{
-	const int size = TABLE_SIZE( symbols );
-
-	for( int i = 0; i < size; ++i )
-	{
-		if( strcmp( name, symbols[i].name ) == 0 )
-		{
-			return &symbols[i];
-		}
-	}
-
-	return NULL;
-}
-
-
+/*
+//  Copyright (c) 2020 Peter Frane Jr. All Rights Reserved.
+//
+//  Use of this source code is governed by the GPL v. 3.0 license that can be
+//  found in the LICENSE file.
+//
+//  This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+//  OF ANY KIND, either express or implied.
+//
+//  For inquiries, email the author at pfranejr AT hotmail.com
+*/
+
+#include "tables.h"
+#include <stdio.h>
+	
+static constexpr CommandStruct commandTable[] = {
+{"Overleftarrow",			ci_accent,pt_one, "<mover accent='true'>", "<mo stretchy='true'>&#x21D0;</mo></mover>" },
+{"Overleftrightarrow",		ci_accent,pt_one, "<mover accent='true'>", "<mo stretchy='true'>&#x21D4;</mo></mover>" },
+{"Overrightarrow",			ci_accent,pt_one, "<mover accent='true'>", "<mo stretchy='true'>&#x21D2;</mo></mover>" },
+{"actuarial",				ci_menclose,    pt_one,"<menclose notation='actuarial'>",  "</menclose>" },
+{"acute",					ci_accent,pt_one, "<mover accent='true'>", "<mo>&#x00B4;</mo></mover>" },
+{"bar",						ci_accent,pt_one, "<mover accent='true'>", "<mo stretchy='false'>&#x00AF;</mo></mover>" },
+{"begin",					ci_begin,pt_especial,"", "" },
+{"binom",					ci_binom,pt_two, "<mfenced><mrow><mfrac linethickness='0'>","</mfrac></mrow></mfenced>" },
+{"breve",					ci_accent,pt_one, "<mover accent='true'>", "<mo>&#x02D8;</mo></mover>" },
+{"cfrac",					ci_cfrac,pt_especial,    "<mfrac>", "</mfrac>" },
+{"check",					ci_accent,pt_one, "<mover accent='true'>", "<mo>&#x02C7;</mo></mover>" },
+{"ddddot",					ci_accent,pt_one, "<mover accent='true'>", "<mo>&#x00A8;&#x00A8;</mo></mover>" },
+{"dddot",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x20DB;</mo></mover>" },
+{"ddot",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x00A8;</mo></mover>" },
+{"dfrac",	ci_mfrac,	pt_two,	"<mstyle displaystyle='true' scriptlevel='0'><mfrac>", "</mfrac></mstyle>" },
+{"dot",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x02D9;</mo></mover>" },
+{"end",	ci_end,	pt_especial,	"","" },
+{"eqno",	ci_eqno,	pt_especial,	"<mtable><mlabeledtr><mtd><mtext>", "</mtext></mtd><mtd>" },
+{"frac",	ci_frac,	pt_two,	"<mfrac>", "</mfrac>" },
+{"func",	ci_func,	pt_plain,	"<mi>", "</mi>" },
+{"grave",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x0300;</mo></mover>" },
+{"hat",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x02c6;</mo></mover>" },
+{"hfill",	ci_hfill,	pt_especial,	"","" },
+{"hphantom",	ci_phantom,	pt_one,	"<mphantom><mpadded height='0%' depth='0'>", "</mpadded></mphantom>" },
+{"hungarumlaut",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x02DD;</mo></mover>" },
+{"left",	ci_left,	pt_especial,	"<mfenced>", "</mrow></mfenced>" },
+{"leqno",	ci_eqno,	pt_especial,	"<mtable side='left'><mlabeledtr><mtd><mtext>", "</mtext></mtd><mtd>" },
+{"limits",	ci_limits,	pt_especial,	"","" },
+{"longdiv",	ci_menclose,	pt_one,	"<menclose notation='longdiv'>", "</menclose>" },
+{"lsub",	ci_lsub,	pt_especial,	"<mmultiscripts>", "</mmultiscripts>" },
+{"lsubsup",	ci_lsubsup,	pt_especial,	"<mmultiscripts>", "</mmultiscripts>" },
+{"lsup",	ci_lsup,	pt_especial,	"<mmultiscripts>", "</mmultiscripts>" },
+{"mathbb",	ci_mathfont,	pt_plain,	"<mi mathvariant='double-struck'>", "</mi>" },
+{"mathbf",	ci_mathfont,	pt_plain,	"<mi mathvariant='bold'>", "</mi>" },
+{"mathbfrak",	ci_mathfont,	pt_plain,	"<mi mathvariant='bold-fraktur'>", "</mi>" },
+{"mathbi",	ci_mathfont,	pt_plain,	"<mi mathvariant='bold-italic'>", "</mi>" },
+{"mathbin",	ci_mathbin,	pt_plain,	"<mo lspace='.222222em' rspace='.222222em'>", "</mo>" },
+{"mathbsc",	ci_mathfont,	pt_plain,	"<mi mathvariant='bold-script'>", "</mi>" },
+{"mathbss",	ci_mathfont,	pt_plain,	"<mi mathvariant='bold-sans-serif'>", "</mi>" },
+{"mathfrak",	ci_mathfont,	pt_plain,	"<mi mathvariant='fraktur'>", "</mi>" },
+{"mathit",	ci_mathfont,	pt_plain,	"<mi mathvariant='italic'>", "</mi>" },
+{"mathop",	ci_mathop,	pt_plain,	"<mo>", "</mo>" },
+{"mathord",	ci_mathord,	pt_plain,	"<mo lspace='0' rspace='0'>", "</mo>" },
+{"mathrel",	ci_mathrel,	pt_plain,	"<mo lspace='.27777em' rspace='.27777em'>", "</mo>" },
+{"mathring",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x02DA;</mo></mover>" },
+{"mathrm",	ci_mathfont,	pt_plain,	"<mi mathvariant='normal'>", "</mi>" },
+{"mathsc",	ci_mathfont,	pt_plain,	"<mi mathvariant='script'>", "</mi>" },
+{"mathss",	ci_mathfont,	pt_plain,	"<mi mathvariant='sans-serif'>", "</mi>" },
+{"mathssbi",	ci_mathfont,	pt_plain,	"<mi mathvariant='sans-serif-bold-italic'>", "</mi>" },
+{"mathssi",	ci_mathfont,	pt_plain,	"<mi mathvariant='sans-serif-italic'>", "</mi>" },
+{"mathstrut",	ci_strut,	pt_especial,	"<mphantom><mpadded width='0%' lspace='0'><mo>(</mo></mpadded></mphantom>","" },
+{"mathtt",	ci_mathfont,	pt_plain,	"<mi mathvariant='monospace'>", "</mi>" },
+{"mn",	ci_mn,	pt_plain,	"<mn>", "</mn>" },
+{"mo",	ci_mo,	pt_plain,	"<mo>", "</mo>" },
+{"ms",	ci_mathstring,	pt_especial,	"<ms>", "</ms>" },
+{"nolimits",	ci_limits,	pt_especial,	"","" },
+{"overbrace",	ci_underoverbrace,	pt_especial,	"<mover accent='false'>", "<mo stretchy='true'>&#xFE37;</mo></mover>" },
+{"overbrack",	ci_accent,	pt_one,	"<mover accent='false'>", "<mo stretchy='true'>&#x23B4;</mo></mover>" },
+{"overleftarrow",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo stretchy='true'>&#x2190;</mo></mover>" },
+{"overleftrightarrow",	ci_accent,	pt_one,  	"<mover accent='true'>", "<mo stretchy='true'>&#x2194;</mo></mover>" },
+{"overline",	ci_accent,	pt_one,	"<mover accent='false'>", "<mo stretchy='true'>&#x00AF;</mo></mover>" },
+{"overparen",	ci_accent,	pt_one,	"<mover accent='false'>", "<mo stretchy='true'>&#x2322;</mo></mover>" },
+{"overrightarrow",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo stretchy='true'>&#x2192;</mo></mover>" },
+{"phantom",	ci_phantom,	pt_one,	"<mphantom>", "</mphantom>" },
+{"qdot",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x00A8;&#x00A8;</mo></mover>" },
+{"right",	ci_right,	pt_especial,	"","" },
+{"sqrt",	ci_sqrt,	pt_especial,	"<msqrt>", "</msqrt>" },
+{"stack",	ci_stack,	pt_two,	"<mfrac linethickness='0'>", "</mfrac>" },
+{"stackrel",	ci_stackrel,	pt_especial,	"<mover>", "</mover>" },
+{"strut",	ci_strut,	pt_especial,	"<mspace width='0pt' height='8.5pt' depth='3.5pt'/>","" },
+{"tbinom",	ci_binom,	pt_two,	"<mstyle scriptlevel='1'><mfenced><mrow><mfrac linethickness='0'>", "</mfrac></mrow></mfenced></mstyle>" },
+{"tdot",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo>&#x20DB;</mo></mover>" },
+{"text",	ci_text,	pt_especial,	"<mtext>", "</mtext>" },
+{"textbf",	ci_text,	pt_especial,	"<mtext mathvariant='bold'>", "</mtext>" },
+{"textbi",	ci_text,	pt_especial,	"<mtext mathvariant='bold-italic'>", "</mtext>" },
+{"textbsf",	ci_text,	pt_especial,	"<mtext mathvariant='bold-sans-serif'>", "</mtext>" },
+{"textit",	ci_text,	pt_especial,	"<mtext mathvariant='italic'>", "</mtext>" },
+{"textsf",	ci_text,	pt_especial,	"<mtext mathvariant='sans-serif'>", "</mtext>" },
+{"textsfbi",	ci_text,	pt_especial,	"<mtext mathvariant='sans-serif-bold-italic'>", "</mtext>" },
+{"textsfit",	ci_text,	pt_especial,	"<mtext mathvariant='sans-serif-italic'>", "</mtext>" },
+{"texttt",	ci_text,	pt_especial,	"<mtext mathvariant='monospace'>", "</mtext>" },
+{"tfrac",	ci_mfrac,	pt_two,	"<mstyle displaystyle='false' scriptlevel='0'><mfrac>", "</mfrac></mstyle>" },
+{"tilde",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo stretchy='false'>&#x02DC;</mo></mover>" },
+{"underbrace",	ci_underoverbrace,	pt_especial,	"<munder accentunder='false'>", "<mo stretchy='true'>&#xFE38;</mo></munder>" },
+{"underbrack",	ci_accent,	pt_one,	"<munder accentunder='false'>", "<mo stretchy='true'>&#x23B5;</mo></munder>" },
+{"underleftarrow",	ci_accent,	pt_one,	"<munder accentunder='true'>", "<mo stretchy='true'>&#x2190;</mo></munder>" },
+{"underleftrightarrow",	ci_accent,	pt_one,	"<munder accentunder='true'>", "<mo stretchy='true'>&#x2194;</mo></munder>" },
+{"underline",	ci_accent,	pt_one,	"<munder accentunder='false'>", "<mo stretchy='true'>&#x0332;</mo></munder>" },
+{"underparen",	ci_accent,	pt_one,	"<munder accentunder='false'>", "<mo stretchy='true'>&#xF611;</mo></munder>" },
+{"underrightarrow",	ci_accent,	pt_one,	"<munder accentunder='true'>", "<mo stretchy='true'>&#x2192;</mo></munder>" },
+{"undertilde",	ci_accent,	pt_one,	"<munder accentunder='false'>", "<mo stretchy='true'>&#x02DC;</mo></munder>" },
+{"vec",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo stretchy='false'>&#x2192;</mo></mover>" },
+{"vphantom",	ci_phantom,	pt_one,	"<mphantom><mpadded width='0%' lspace='0'>", "</mpadded></mphantom>" },
+{"widehat",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo stretchy='true'>&#x0302;</mo></mover>" },
+{"widetilde",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo stretchy='true'>&#x02DC;</mo></mover>" },
+{"widevec",	ci_accent,	pt_one,	"<mover accent='true'>", "<mo stretchy='true'>&#x2192;</mo></mover>" },
+{"xleftarrow",	ci_ext_arrows,	pt_especial,	"<mo stretchy='true'>&#x2190;</mo>", "</mover>" },
+{"xleftrightarrow",	ci_ext_arrows,	pt_especial,	"<mo stretchy='true'>&#x2194;</mo>", "</mover>"},
+{"xrightarrow",	ci_ext_arrows,	pt_especial,	"<mo stretchy='true'>&#x2192;</mo>", "</mover>" }
+};
+
+static constexpr EnvironmentStruct environmentTable[] = {
+	{ "Bmatrix",  ci_Bmatrix,   "<mfenced open='{' close='}' separators=''><mtable><mtr><mtd>", "</mtd></mtr></mtable></mfenced>" },	
+	{ "Vmatrix",  ci_Vmatrix,   "<mfenced open='&#x2016;' close='&#x2016;' separators=''><mtable><mtr><mtd>", "</mtd></mtr></mtable></mfenced>" },
+	{ "array",	  ci_array,	   "<mtable><mtr><mtd>", "</mtd></mtr></mtable>" },
+	{ "bmatrix",  ci_bmatrix,   "<mfenced open='[' close=']' separators=''><mtable><mtr><mtd>", "</mtd></mtr></mtable></mfenced>" },
+	{ "cases",    ci_cases,     "<mfenced open='{' close='' separators=''><mtable><mtr><mtd>", "</mtd></mtr></mtable></mfenced>" },
+	{ "eqnarray", ci_eqnarray, "<mtable columnalign='right center left' columnspacing='.222222em'><mtr><mtd>", "</mtd></mtr></mtable>" },
+	{ "matrix",	  ci_matrix,   "<mtable><mtr><mtd>", "</mtd></mtr></mtable>" },
+	{ "pmatrix",  ci_pmatrix,   "<mfenced separators=''><mtable><mtr><mtd>", "</mtd></mtr></mtable></mfenced>" },
+	{ "vmatrix",  ci_vmatrix,   "<mfenced open='|' close='|' separators=''><mtable><mtr><mtd>", "</mtd></mtr></mtable></mfenced>" }
+};
+
+static constexpr FunctionStruct functionTable[] = {
+	{ "Pr",			"Pr",  				  mt_func_limits},
+	{ "arccos",		"arccos", 			  mt_func},
+	{ "arcsin",		"arcsin",  			  mt_func},
+	{ "arctan",		"arctan", 			  mt_func},
+	{ "arg",		"arg",    			  mt_func},
+	{ "cos",		"cos",    			  mt_func},
+	{ "cosh",		"cosh",   			  mt_func},
+	{ "cot",		"cot",    			  mt_func},
+	{ "coth",		"coth",   			  mt_func},
+	{ "csc",		"csc",    			  mt_func},
+	{ "deg",		"deg",    			  mt_func},
+	{ "det",		"det",  			  mt_func_limits},
+	{ "dim",		"dim",    			  mt_func},
+	{ "exp",		"exp",    			  mt_func},
+	{ "gcd",		"gcd",  			  mt_func_limits},
+	{ "hom",		"hom",    			  mt_func},
+	{ "inf",		"inf",  			  mt_func_limits},
+	{ "ker",		"ker",    			  mt_func},
+	{ "lg",			"lg",     			  mt_func},
+	{ "lim",		"lim",  			  mt_func_limits},
+	{ "liminf",		"lim&#x2009;sup",	  mt_func_limits},		
+	{ "limsup",		"lim&#x2009;sup",	  mt_func_limits},		
+	{ "ln",			"ln",     			  mt_func},
+	{ "log",		"log",    			  mt_func},
+	{ "max",		"max",  			  mt_func_limits},
+	{ "min",		"min",  			  mt_func_limits},	
+	{ "sec",		"sec",    			  mt_func},
+	{ "sin",		"sin",     			  mt_func},
+	{ "sinh",		"sinh",   			  mt_func},
+	{ "sup",		"sup",  			  mt_func_limits},
+	{ "tan",		"tan",    			  mt_func},
+	{ "tanh",		"tanh",   			  mt_func}
+};
+
+
+static constexpr EntityStruct entityTable[] = {
+
+{ "Delta",  	0x394, mt_ident }, 
+{ "Gamma",  	0x393, mt_ident }, 
+{ "Lambda",  0x39B, mt_ident }, 
+{ "Omega",  0x3A9, mt_ident }, 
+{ "Phi",  0x3A6, mt_ident }, 
+{ "Psi",  0x3A8, mt_ident }, 
+{ "Sigma",  0x3A3, mt_ident }, 
+{ "Xi",  0x39E, mt_ident }, 
+{ "alpha",		0x3B1,	mt_ident },
+{ "ast",  		0x2A, mt_bin }, 
+{ "beta",		0x3B2,	mt_ident  },
+{ "bigcap",		0x22C2, mt_mov_limits  },
+
+{ "bigcup",		0x22C3, mt_mov_limits  },
+
+{ "bigodot",	0x2299,	mt_mov_limits  },
+
+{ "bigoplus",	0x2295,	mt_mov_limits  },
+
+{ "bigotimes",	0x2297,	mt_mov_limits  },
+
+{ "bigsqcup",	0x2A06,	mt_mov_limits  },
+
+{ "biguplus",	0x2A04,	mt_mov_limits  },
+
+{ "bigvee",		0x22C1,	mt_mov_limits  },
+
+{ "bigwedge",	0x22C0,	mt_mov_limits  },
+
+{ "cdot",  		0xB7, mt_bin }, 
+{ "cdots",  	0x22EF, mt_ord }, 
+{ "centerdot",  0xB7, mt_bin }, 
+{ "chi",  		0x3C7, mt_ident }, 
+{ "coprod",		0x2210, mt_mov_limits  },
+
+{ "ddots",  	0x22F1, mt_ord }, 
+{ "delta",  	0x3B4, mt_ident }, 
+{ "div",  		0xF7, mt_bin }, 
+{ "epsilon",  	0x3B5, mt_ident }, 
+{ "gamma",  	0x3B3, mt_ident }, 
+{ "ge",  		0x2265, mt_rel }, 
+{ "iiiint",		0x2A0C,	mt_limits   },
+
+{ "iiint",		0x222D,	mt_limits   },
+
+{ "iint",		0x222C,	mt_limits   },
+
+{ "infinity",  0x221E, mt_rel }, 
+{ "int",		0x222B,	mt_limits   },
+
+{ "kappa",  0x3BA, mt_ident }, 
+{ "lambda",  0x3BB, mt_ident }, 
+{ "ldots",  0x2026, mt_ord }, 
+{ "le",  0x2264, mt_rel }, 
+{ "leftarrow",  0x2190, mt_rel }, 
+
+
+
+{ "mu",  0x3BC, mt_ident }, 
+
+{ "nabla",  0x2207, mt_ident }, 
+{ "nu",  0x3BD, mt_ident }, 
+{ "oint",		0x222E,	mt_limits   },
+
+
+{ "omega",  0x3C9, mt_ident }, 
+{ "partial",  0x2202, mt_ord }, 
+{ "phi",  0x3C6, mt_ident }, 
+{ "pi",  0x3C0, mt_ident }, 
+{ "pm",  0xB1, mt_rel }, 
+
+{ "prod",		0x220f,	mt_mov_limits  },
+{ "psi",  0x3C8, mt_ident }, 
+
+{ "rho",  0x3C1, mt_ident }, 
+{ "rightarrow",  0x2192, mt_rel }, 
+{ "sigma",  0x3C3, mt_ident }, 
+{ "sim",  0x223C, mt_rel }, 
+{ "sum",		0x2211,	mt_mov_limits  },
+
+{ "tau",  0x3C4, mt_ident }, 
+{ "theta",  0x3B8, mt_ident }, 
+{ "times",  0xD7, mt_bin }, 
+{ "to",  0x2192, mt_rel }, 
+{ "upsilon",  0x3C5, mt_ident },
+{ "varepsilon",  0x3B5, mt_ident },
+{ "vdots",  0x22EE, mt_ord }, 
+{ "xi",  0x3BE, mt_ident },
+{ "zeta",  0x3B6, mt_ident } 
+
+
+};
+
+static ErrorTable errorTable[] = {
+	{ ex_out_of_memory,							"Out of memory" },
+	{ ex_missing_lbrace,						"Missing '{'" },
+	{ ex_prefix_superscript,					"Illegal prefix superscript: use the '\\lsup' command" },
+	{ ex_prefix_subscript,						"Illegal prefix subscript: use the '\\lsub' command" },
+	{ ex_misplaced_column_separator,			"Misplaced column separator" },		
+	{ ex_more_rbrace_than_lbrace,				"Syntax error: more '}' than '{'" },
+	{ ex_control_name_too_long,					"Control name too long: maximum is 32" },
+	{ ex_misplaced_row_separator,				"Misplaced row separator" },
+	{ ex_illegal_subscript,						"Illegal subscript" },
+	{ ex_illegal_superscript,					"Illegal superscript" },
+	{ ex_undefined_control_sequence,			"Undefined control sequence" },
+	{ ex_misplaced_inline_formula,				"Misplaced inline formula" },
+	{ ex_missing_parameter,						"Missing parameter" },
+	{ ex_more_lbrace_than_rbrace,				"Syntax error: more '{' than '}'" },	
+	{ ex_double_superscript,					"Double superscript" },
+	{ ex_double_subscript,						"Double subscript" },
+	{ ex_use_subscript_before_superscript,      "Use subscript first as the element is <msubsup>" },
+	{ ex_internal_error,						"Internal error" },
+	{ ex_missing_end_tag,						"Missing end tag" },
+	{ ex_undefined_environment_type,			"Undefined environment type" },
+	{ ex_unknown_alignment_character,			"Unknown alignment character" },
+	{ ex_missing_begin,							"Missing \\begin" },
+	{ ex_missing_end,							"Missing \\end" },
+	{ ex_mismatched_environment_type,           "Mismatched environment type"},
+	{ ex_too_many_columns,						"Too many columns" },
+	{ ex_unknown_attribute,						"Unknown attribute" },
+	{ ex_no_command_allowed,					"Command not allowed here" },
+	{ ex_misplaced_limits,						"Limit controls must follow a math operator" },
+	{ ex_missing_fence_parameter,				"Missing fence parameter" },
+	{ ex_not_math_mode,							"Not in math mode" },
+	{ ex_missing_right_sq_bracket,				"Missing ']'" },
+	{ ex_missing_dollar_symbol,					"Missing '$'" },
+	{ ex_missing_left_fence,					"Missing \\left" },
+	{ ex_missing_right_fence,					"Missing \\right" },
+	{ ex_ambiguous_script,						"Ambiguous script; use \\left and \\right" },
+	{ ex_misplaced_eqno,						"Equation number not allowed here" },
+	{ ex_duplicate_eqno,						"Duplicate equation number" },
+	{ ex_missing_column_alignment,				"Missing column alignment" },
+	{ ex_missing_subsup_base,					"Missing subscript/superscript base" },
+	{ ex_unknown_character,						"Internal error: Unknown character" },
+	{ ex_unhandled_mathtype,					"Internal error: unhandled math type" },
+	{ ex_nesting_too_deep,						"Too many nested groups" }
+	//{ ex_misplaced_nolimits,					"Nolimits control must follow a math operator" }
+};
+
+SymbolTable mathvariant[]= {	
+	{"bb",		"double-struck"},		
+	{"bf",		"bold"},		
+	{"bfrak",	"bold-fraktur"},		
+	{"bi",		"bold-italic"},		
+	{"bsc",		"bold-script"},		
+	{"bss",		"bold-sans-serif"},		
+	{"frak",	"fraktur"},		
+	{"it",		"italic"},		
+	{"rm",		"normal"}, 		
+	{"sc",		"script"},		
+	{"ss",		"sans-serif"},		
+	{"ssbi",	"sans-serif-bold-italic"},		
+	{"ssi",		"sans-serif-italic"},		
+	{"tt",		"monospace"}
+};
+
+static constexpr EntityStruct fenceTable[] = {
+
+	{ "[",      	    '[',		mt_left_fence },
+    { "]",      	    ']',		mt_right_fence },
+    { "\\{",      	    '{',		mt_left_fence },
+    { "\\}",      	    '}',		mt_right_fence },
+    { "/",      	    '/',		mt_ord },
+    { "(",      	    '(',		mt_left_fence },
+    { ")",      	    ')',		mt_right_fence },
+    { "|",				0x007C,		mt_ord },
+    { "\\|",			0x2016,		mt_ord },
+    { "<",				0x2329,		mt_left_fence },
+    { ">",				0x232A,		mt_right_fence },
+    { ".",				0,			mt_ord },  //see function below
+    { "lgroup",      	'(',		mt_left_fence },
+    { "rgroup",      	')',		mt_right_fence },
+   	{ "langle",			0x2329,		mt_left_fence },
+    { "rangle",			0x232A,		mt_right_fence },
+    { "lAngle",			0x300A,		mt_left_fence },
+    { "rAngle",			0x300B,		mt_right_fence },
+    { "lfloor",			0x230A,		mt_left_fence },//'&lfloor}, //0x230A},
+    { "rfloor",			0x230B,		mt_right_fence },//'&rfloor}, //0x230B},
+    { "lceil",			0x2308,		mt_left_fence },//'&lceil},  // 0x2308},
+    { "rceil",			0x2309,		mt_right_fence },//'&rceil}, // 0x2309},
+    { "lbrack",			'[',		mt_left_fence },
+    { "rbrack",			']',		mt_right_fence },
+    { "lBrack",			0x301A,		mt_left_fence },
+    { "rBrack",			0x301B,		mt_right_fence },
+    { "lbrace",			'{',		mt_left_fence },
+    { "rbrace",			'}',		mt_right_fence },
+    { "backslash",		'\\',		mt_ord },
+    { "vert",			0x007C,		mt_ord },
+    { "Vert",			0x2016,		mt_ord },
+    { "uparrow",		0x2191,		mt_ord },
+    { "Uparrow",		0x21D1,		mt_ord },
+    { "downarrow",		0x2193,		mt_ord },
+    { "Downarrow",		0x21D3,		mt_ord },
+    { "updownarrow",	0x2195,		mt_ord },
+    { "Updownarrow",	0x21D5,		mt_ord },
+    { "lmoustache",		0x23B0,		mt_left_fence }, //0x23B0},
+    { "rmoustache",		0x23B1,		mt_right_fence }, //0x23B1},
+    { "lmoust",  	    0x23B0,		mt_left_fence },
+    { "rmoust",			0x23B1,		mt_right_fence }
+};
+
+// thickspace .27777 
+// medspace	  .222222em
+// thinspace	.16667em
+static constexpr SymbolStruct symbols[]= {
+	{"\\ ",		"&#x00a0;",  	"<mspace width='.25em'/>", 			mt_ord },
+	{"\\,",		"&#x2006;",  	"<mspace width='.16667em'/>", 		mt_ord },
+	{"\\:",		"&#x205f;",  	"<mspace width='.222222em'/>", 		mt_ord },
+	{"\\>",		"&#x205f;",  	"<mspace width='.222222em'/>", 		mt_ord },
+	{"\\;",		"&#x2005;",  	"<mspace width='.27777em'/>", 		mt_ord },
+	{"\\!",		"&#x200a;",  	"<mspace width='-.16667em'/>",  	mt_ord },
+	{"\\~",		"&#x00a0;",  	"<mo>&#x00A0;</mo>",  				mt_ord },
+	{"\\|",		"&#x2016;", 	"<mo mathsize='1'>&#x2016;</mo>", 	mt_fence },
+	{"\\{",		"{",	   		"<mo mathsize='1'>{</mo>", 	        mt_left_fence },
+	{"\\}",		"}",	   		"<mo mathsize='1'>}</mo>", 	        mt_right_fence },
+	//{"|",		"|",	   		"<mo mathsize='1'>&#x0007C;</mo>", 	mt_ord },
+	{"|",		"|",	   		"<mo mathsize='1'>|</mo>", 			mt_ord },
+	{"[",		"[",  	   		"<mo mathsize='1'>[</mo>", 			mt_left_fence },
+	{"]",		"]",  	   		"<mo mathsize='1'>]</mo>", 			mt_right_fence },
+	{"(",		"(",  	   		"<mo mathsize='1'>(</mo>", 			mt_left_fence },
+	{")",		")",  	   		"<mo mathsize='1'>)</mo>", 			mt_right_fence },
+	{"<",		"<",  	   		"<mo mathsize='1'>&lt;</mo>", 		mt_left_fence },
+	{">",		">",  	   		"<mo mathsize='1'>&gt;</mo>", 		mt_right_fence },
+	{"-",		"-",			"<mo>&#x2212;</mo>", 				mt_bin_unary },
+	{"`",		"&#x0300;",		"<mo>&#x0300;</mo>", 				mt_ord },
+	{"@",		"&#x0040;",		"<mo>&#x0040;</mo>",            	mt_ord },
+	{"*",		"*",			"<mo>*</mo>",                   	mt_ord },
+	{"'",		"&#x02032;",	"<mo>&#x02032;</mo>",           	mt_ord },
+	{"''",		"&#x02033;",	"<mo>&#x02033;</mo>",           	mt_ord },
+	{"'''",		"&#x02034;",	"<mo>&#x02034;</mo>",           	mt_ord },
+	{"\"",		"&#x0201D;",	"<mo>&#x0201D;</mo>",           	mt_ord },
+	{"/",		"/",			"<mtext>/</mtext>",             	mt_ord },
+	{"\\/",		"&#x200b;",		"<mo>&#x200b;</mo>",            	mt_ord },	
+	{"\\%",		"%",			"<mo>%</mo>", 						mt_ord },
+	{"\\#",		"&#x00023;",	"<mo>&#x00023;</mo>", 				mt_ord },
+	{"\\$",		"$",			"<mtext>$</mtext>", 				mt_ord },
+	{"\\^",		"&#x02C6;",		"<mo>&#x02C6;</mo>", 				mt_ord },
+	{"\\&",		"&amp;",		"<mo>&amp;</mo>", 					mt_ord },
+	{"\\_",		"&#x0005F;",	"<mo>&#x0005F;</mo>", 				mt_ord },
+	{"\\-",		"&#x200b;",		"<mo>&#x200b;</mo>", 				mt_ord },
+	{"!",		"!",			"<mo>!</mo>",   					mt_ord },
+	{"+",		"+",			"<mo>+</mo>",						mt_bin_unary },
+	{"=",		"=",			"<mo>=</mo>",						mt_bin },
+	{":",		":",			"<mo>:</mo>",						mt_bin },
+	{";",		";",			"<mo>;</mo>",						mt_ord },
+	{",",		",",			"<mo>,</mo>",						mt_punct },
+	{".",		".",			"<mo>.</mo>",						mt_ord },
+	{"?",		"?",			"<mo>?</mo>",						mt_ord }
+};
+
+#define TABLE_SIZE(x)  ( sizeof( (x) )/sizeof( (x)[0] ))
+
+
+inline int fastCompare( const char *s1, const char *s2 )
+{
+	return ( ( *s1 == *s2 ) ? strcmp( s1, s2 ) : *s1 - *s2 );
+}
+
+
+// The control names of the command, entity and function tables share
+// one perfect hash built by the compiler: a name is found with one hash
+// of its characters and one strcmp. The tables must stay sorted by name
+// and free of duplicates; the build stops if they are not.
+
+constexpr int constCompare( const char *s1, const char *s2 )
+{
+	while( ( *s1 != '\0' ) && ( *s1 == *s2 ) )
+	{
+		++s1;
+		++s2;
+	}
+
+	return (unsigned char) *s1 - (unsigned char) *s2;
+}
+
+template<typename T, size_t N>
+constexpr bool isSortedTable( const T (&table)[N] )
+{
+	for( size_t i = 1; i < N; ++i )
+	{
+		if( constCompare( table[i - 1].name, table[i].name ) >= 0 )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static_assert( isSortedTable( commandTable ), "commandTable must be sorted by name, without duplicates" );
+static_assert( isSortedTable( entityTable ), "entityTable must be sorted by name, without duplicates" );
+static_assert( isSortedTable( functionTable ), "functionTable must be sorted by name, without duplicates" );
+static_assert( isSortedTable( environmentTable ), "environmentTable must be sorted by name, without duplicates" );
+
+// FNV-1a over the name, then a seed-dependent mix picks the slot
+
+constexpr unsigned int hashName( const char *name )
+{
+	unsigned int h = 2166136261u;
+
+	while( *name != '\0' )
+	{
+		h = ( h ^ (unsigned char) *name++ ) * 16777619u;
+	}
+
+	return h;
+}
+
+constexpr unsigned int hashSlot( unsigned int h, unsigned int seed )
+{
+	h ^= seed * 0x9E3779B9u;
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35u;
+	h ^= h >> 16;
+
+	return h;
+}
+
+// hash and displace: the names are spread over BUCKETS buckets and each
+// bucket, largest first, gets the first seed that sends all its names to
+// free slots. SLOTS and BUCKETS must be powers of two.
+
+template<size_t SLOTS, size_t BUCKETS>
+struct PerfectHash {
+	unsigned short seed[BUCKETS];
+	short slot[SLOTS];		// index of the name in the table, or -1
+};
+
+enum { HASH_MAX_SEED = 0xFFFF };
+
+template<size_t SLOTS, size_t BUCKETS, typename T, size_t N>
+constexpr PerfectHash<SLOTS, BUCKETS> buildHash( const T (&table)[N] )
+{
+	PerfectHash<SLOTS, BUCKETS> hash = {};
+	unsigned int h[N] = {};
+	size_t count[BUCKETS] = {};
+
+	static_assert( N < SLOTS, "too many names for the hash table" );
+
+	for( size_t i = 0; i < SLOTS; ++i )
+	{
+		hash.slot[i] = -1;
+	}
+
+	for( size_t i = 0; i < N; ++i )
+	{
+		for( size_t j = 0; j < i; ++j )
+		{
+			if( constCompare( table[i].name, table[j].name ) == 0 )
+			{
+				throw "duplicate name";		// not a constant expression: stops the build
+			}
+		}
+
+		h[i] = hashName( table[i].name );
+		++count[ h[i] & ( BUCKETS - 1 ) ];
+	}
+
+	for( size_t size = N; size > 0; --size )
+	{
+		for( size_t b = 0; b < BUCKETS; ++b )
+		{
+			if( count[b] != size )
+			{
+				continue;
+			}
+
+			for( unsigned int seed = 1; ; ++seed )
+			{
+				bool fits = true;
+
+				if( seed > HASH_MAX_SEED )
+				{
+					throw "no seed found; make the hash table larger";
+				}
+
+				for( size_t i = 0; fits && ( i < N ); ++i )
+				{
+					if( ( h[i] & ( BUCKETS - 1 ) ) != b )
+					{
+						continue;
+					}
+
+					size_t s = hashSlot( h[i], seed ) & ( SLOTS - 1 );
+
+					if( hash.slot[s] != -1 )
+					{
+						fits = false;
+					}
+
+					for( size_t j = 0; fits && ( j < i ); ++j )
+					{
+						if( ( ( h[j] & ( BUCKETS - 1 ) ) == b ) && ( ( hashSlot( h[j], seed ) & ( SLOTS - 1 ) ) == s ) )
+						{
+							fits = false;
+						}
+					}
+				}
+
+				if( fits )
+				{
+					for( size_t i = 0; i < N; ++i )
+					{
+						if( ( h[i] & ( BUCKETS - 1 ) ) == b )
+						{
+							hash.slot[ hashSlot( h[i], seed ) & ( SLOTS - 1 ) ] = (short) i;
+						}
+					}
+
+					hash.seed[b] = (unsigned short) seed;
+					break;
+				}
+			}
+		}
+	}
+
+	return hash;
+}
+
+template<size_t SLOTS, size_t BUCKETS, typename T, size_t N>
+inline const T *findName( const PerfectHash<SLOTS, BUCKETS> &hash, const T (&table)[N], const char *name )
+{
+	unsigned int h;
+	short i;
+
+	h = hashName( name );
+	i = hash.slot[ hashSlot( h, hash.seed[ h & ( BUCKETS - 1 ) ] ) & ( SLOTS - 1 ) ];
+
+	if( ( i >= 0 ) && ( strcmp( table[i].name, name ) == 0 ) )
+	{
+		return &table[i];
+	}
+
+	return NULL;
+}
+
+// output fragments, built at compile time so that emitting an entity,
+// a function or a fence attribute is a single copy
+
+constexpr void addText( Fragment &fragment, const char *s )
+{
+	while( *s )
+	{
+		if( fragment.len >= FRAGMENT_SIZE )
+		{
+			throw "fragment too long";		// not a constant expression: stops the build
+		}
+		fragment.text[fragment.len++] = *s++;
+	}
+}
+
+constexpr void addChar( Fragment &fragment, char c )
+{
+	char s[2] = { c, '\0' };
+
+	addText( fragment, s );
+}
+
+// writes &#x<code>; the way printf's %x does
+
+constexpr void addCodepoint( Fragment &fragment, unsigned int code )
+{
+	char digits[9] = {};
+	int n = 0;
+
+	do
+	{
+		digits[n++] = "0123456789abcdef"[code & 0xF];
+		code >>= 4;
+	} while( code != 0 );
+
+	addText( fragment, "&#x" );
+
+	while( n > 0 )
+	{
+		addChar( fragment, digits[--n] );
+	}
+	addChar( fragment, ';' );
+}
+
+constexpr const char *entityTag( math_type mathType )
+{
+	switch( mathType )
+	{
+	case mt_ident:
+		return "mi";
+	case mt_digit:
+		return "mn";
+	case mt_ord:
+	case mt_punct:
+	case mt_limits:
+	case mt_mov_limits:
+	case mt_rel:
+	case mt_bin:
+	case mt_unary:
+	case mt_bin_unary:
+		return "mo";
+	case mt_left_fence:
+	case mt_right_fence:
+	case mt_fence:
+		return "mo mathsize='1'";
+	case mt_text:
+		return "mtext";
+	default:
+		return NULL;	// rejected by the parser
+	}
+}
+
+constexpr Fragment makeElement( const char *tag, const Fragment &content )
+{
+	Fragment fragment = {};
+	const char *p = tag;
+
+	addChar( fragment, '<' );
+	addText( fragment, tag );
+	addChar( fragment, '>' );
+
+	for( size_t i = 0; i < content.len; ++i )
+	{
+		addChar( fragment, content.text[i] );
+	}
+
+	addText( fragment, "</" );
+
+	while( ( *p != '\0' ) && ( *p != ' ' ) )
+	{
+		addChar( fragment, *p++ );
+	}
+	addChar( fragment, '>' );
+
+	return fragment;
+}
+
+struct ControlFragments {
+	Fragment entityElement[TABLE_SIZE( entityTable )];
+	Fragment entityLiteral[TABLE_SIZE( entityTable )];
+	Fragment functionElement[TABLE_SIZE( functionTable )];
+	Fragment functionLiteral[TABLE_SIZE( functionTable )];
+};
+
+constexpr ControlFragments makeControlFragments()
+{
+	ControlFragments fragments = {};
+
+	for( size_t i = 0; i < TABLE_SIZE( entityTable ); ++i )
+	{
+		const char *tag = entityTag( entityTable[i].mathType );
+
+		addCodepoint( fragments.entityLiteral[i], entityTable[i].code );
+
+		if( tag != NULL )
+		{
+			fragments.entityElement[i] = makeElement( tag, fragments.entityLiteral[i] );
+		}
+	}
+
+	for( size_t i = 0; i < TABLE_SIZE( functionTable ); ++i )
+	{
+		addText( fragments.functionLiteral[i], functionTable[i].output );
+		fragments.functionElement[i] = makeElement( "mi", fragments.functionLiteral[i] );
+	}
+
+	return fragments;
+}
+
+static constexpr ControlFragments controlFragments = makeControlFragments();
+
+struct FenceFragments {
+	Fragment left[TABLE_SIZE( fenceTable )];
+	Fragment right[TABLE_SIZE( fenceTable )];
+	Fragment element[TABLE_SIZE( fenceTable )];
+};
+
+constexpr void addFence( Fragment &fragment, const EntityStruct &fence )
+{
+	if( fence.code < 256 ) // ascii
+	{
+		if( fence.code != 0 )
+		{
+			addChar( fragment, (char) fence.code );
+		}
+	}
+	else
+	{
+		addCodepoint( fragment, fence.code );
+	}
+}
+
+constexpr FenceFragments makeFenceFragments()
+{
+	FenceFragments fragments = {};
+
+	for( size_t i = 0; i < TABLE_SIZE( fenceTable ); ++i )
+	{
+		addText( fragments.left[i], " left='" );
+		addFence( fragments.left[i], fenceTable[i] );
+		addChar( fragments.left[i], '\'' );
+
+		addText( fragments.right[i], " right='" );
+		addFence( fragments.right[i], fenceTable[i] );
+		addText( fragments.right[i], "'><mrow>" );
+
+		if( fenceTable[i].code != 0 )
+		{
+			addText( fragments.element[i], "<mo fence='true'>" );
+			addFence( fragments.element[i], fenceTable[i] );
+			addText( fragments.element[i], "</mo>" );
+		}
+	}
+
+	return fragments;
+}
+
+static constexpr FenceFragments fenceFragments = makeFenceFragments();
+
+/*
+
+ OUTPUT STYLES: compact output has characters as UTF-8 instead of
+ character references, and no attribute that only restates the default
+ (mathsize='1'). MathML Core has no <mfenced>: its fences are <mo>s in
+ an <mrow>. The tables of each style are the others rewritten at
+ compile time
+
+*/
+
+constexpr size_t textLength( const char *s )
+{
+	size_t len = 0;
+
+	while( s[len] != '\0' )
+	{
+		++len;
+	}
+
+	return len;
+}
+
+constexpr int hexValue( char c )
+{
+	return ( ( c >= '0' ) && ( c <= '9' ) ) ? c - '0' :
+		   ( ( c >= 'a' ) && ( c <= 'f' ) ) ? c - 'a' + 10 :
+		   ( ( c >= 'A' ) && ( c <= 'F' ) ) ? c - 'A' + 10 : -1;
+}
+
+// the character of the reference &#x...; at s, with the length of the
+// reference in 'len'; 0 if there is none or if the character has to
+// stay a reference in XML
+
+constexpr unsigned int characterReference( const char *s, size_t left, size_t &len )
+{
+	unsigned int code = 0;
+	size_t i = 3;
+
+	if( ( left < 4 ) || ( s[0] != '&' ) || ( s[1] != '#' ) || ( s[2] != 'x' ) )
+	{
+		return 0;
+	}
+
+	while( ( i < left ) && ( hexValue( s[i] ) >= 0 ) )
+	{
+		code = code * 16 + hexValue( s[i++] );
+	}
+
+	if( ( i == 3 ) || ( i == left ) || ( s[i] != ';' ) || ( code < 0x20 ) || ( code > 0x10FFFF ) )
+	{
+		return 0;
+	}
+
+	switch( code )
+	{
+	case '<':
+	case '>':
+	case '&':
+	case '\'':
+	case '"':
+		return 0;
+	default:
+		len = i + 1;
+		return code;
+	}
+}
+
+// writes 'code' as UTF-8 to dest, if not NULL, and returns its length
+
+constexpr size_t addUtf8( char *dest, unsigned int code )
+{
+	char bytes[4] = {};
+	size_t len = 0;
+
+	if( code < 0x80 )
+	{
+		bytes[0] = (char) code;
+		len = 1;
+	}
+	else if( code < 0x800 )
+	{
+		bytes[0] = (char) ( 0xC0 | ( code >> 6 ) );
+		bytes[1] = (char) ( 0x80 | ( code & 0x3F ) );
+		len = 2;
+	}
+	else if( code < 0x10000 )
+	{
+		bytes[0] = (char) ( 0xE0 | ( code >> 12 ) );
+		bytes[1] = (char) ( 0x80 | ( ( code >> 6 ) & 0x3F ) );
+		bytes[2] = (char) ( 0x80 | ( code & 0x3F ) );
+		len = 3;
+	}
+	else
+	{
+		bytes[0] = (char) ( 0xF0 | ( code >> 18 ) );
+		bytes[1] = (char) ( 0x80 | ( ( code >> 12 ) & 0x3F ) );
+		bytes[2] = (char) ( 0x80 | ( ( code >> 6 ) & 0x3F ) );
+		bytes[3] = (char) ( 0x80 | ( code & 0x3F ) );
+		len = 4;
+	}
+
+	for( size_t i = 0; ( dest != NULL ) && ( i < len ); ++i )
+	{
+		dest[i] = bytes[i];
+	}
+
+	return len;
+}
+
+static constexpr char defaultSize[] = " mathsize='1'";
+
+constexpr bool hasDefaultSize( const char *s, size_t left )
+{
+	if( left < sizeof( defaultSize ) - 1 )
+	{
+		return false;
+	}
+
+	for( size_t i = 0; i < sizeof( defaultSize ) - 1; ++i )
+	{
+		if( s[i] != defaultSize[i] )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// writes the compact form of the 'len' bytes at s to dest, if not NULL,
+// and returns its length
+
+constexpr size_t compactText( const char *s, size_t len, char *dest )
+{
+	size_t n = 0, i = 0, skip = 0;
+	unsigned int code = 0;
+
+	while( i < len )
+	{
+		code = characterReference( s + i, len - i, skip );
+
+		if( code != 0 )
+		{
+			n += addUtf8( ( dest != NULL ) ? dest + n : NULL, code );
+			i += skip;
+		}
+		else if( hasDefaultSize( s + i, len - i ) )
+		{
+			i += sizeof( defaultSize ) - 1;
+		}
+		else
+		{
+			if( dest != NULL )
+			{
+				dest[n] = s[i];
+			}
+			++n;
+			++i;
+		}
+	}
+
+	return n;
+}
+
+constexpr Fragment compactFragment( const Fragment &fragment )
+{
+	Fragment compact = {};
+
+	compact.len = (unsigned char) compactText( fragment.text, fragment.len, compact.text );
+
+	return compact;
+}
+
+constexpr ControlFragments makeCompactFragments()
+{
+	ControlFragments fragments = {};
+
+	for( size_t i = 0; i < TABLE_SIZE( entityTable ); ++i )
+	{
+		fragments.entityElement[i] = compactFragment( controlFragments.entityElement[i] );
+		fragments.entityLiteral[i] = compactFragment( controlFragments.entityLiteral[i] );
+	}
+
+	for( size_t i = 0; i < TABLE_SIZE( functionTable ); ++i )
+	{
+		fragments.functionElement[i] = compactFragment( controlFragments.functionElement[i] );
+		fragments.functionLiteral[i] = compactFragment( controlFragments.functionLiteral[i] );
+	}
+
+	return fragments;
+}
+
+static constexpr ControlFragments compactFragments = makeCompactFragments();
+
+constexpr FenceFragments makeCompactFenceFragments()
+{
+	FenceFragments fragments = {};
+
+	for( size_t i = 0; i < TABLE_SIZE( fenceTable ); ++i )
+	{
+		fragments.left[i]	 = compactFragment( fenceFragments.left[i] );
+		fragments.right[i]	 = compactFragment( fenceFragments.right[i] );
+		fragments.element[i] = compactFragment( fenceFragments.element[i] );
+	}
+
+	return fragments;
+}
+
+static constexpr FenceFragments compactFenceFragments = makeCompactFenceFragments();
+
+enum { STYLE_TEXT_SIZE = 128 };
+
+constexpr bool hasText( const char *s, const char *text )
+{
+	while( ( *text != '\0' ) && ( *s == *text ) )
+	{
+		++s;
+		++text;
+	}
+
+	return ( *text == '\0' );
+}
+
+constexpr size_t putText( char *dest, size_t n, const char *s, size_t len )
+{
+	if( n + len >= STYLE_TEXT_SIZE )
+	{
+		throw "table text too long";		// not a constant expression: stops the build
+	}
+
+	for( size_t i = 0; i < len; ++i )
+	{
+		dest[n++] = s[i];
+	}
+
+	return n;
+}
+
+// writes the value of the attribute 'name' of the <mfenced> start tag
+// at 'tag', or 'absent' if it has none, as an <mo>; nothing if the value
+// is empty
+
+constexpr size_t putCoreFence( char *dest, size_t n, const char *tag, const char *name, const char *absent )
+{
+	const char *value = absent;
+	size_t len = textLength( absent );
+
+	for( ; ( *tag != '\0' ) && ( *tag != '>' ); ++tag )
+	{
+		if( hasText( tag, name ) )
+		{
+			value = tag + textLength( name );
+
+			for( len = 0; ( value[len] != '\0' ) && ( value[len] != '\'' ); ++len )
+			{
+			}
+			break;
+		}
+	}
+
+	if( len != 0 )
+	{
+		n = putText( dest, n, "<mo fence='true'>", 17 );
+		n = putText( dest, n, value, len );
+		n = putText( dest, n, "</mo>", 5 );
+	}
+
+	return n;
+}
+
+// writes s with every <mfenced> as an <mrow> and its fences as <mo>s;
+// the fences of an </mfenced> are in the start tag 'on' of the record
+
+constexpr size_t coreText( const char *s, const char *on, char *dest )
+{
+	size_t n = 0;
+
+	while( *s != '\0' )
+	{
+		if( hasText( s, "<mfenced" ) )
+		{
+			n = putText( dest, n, "<mrow>", 6 );
+			n = putCoreFence( dest, n, s, " open='", "(" );
+
+			while( *s++ != '>' )
+			{
+			}
+		}
+		else if( hasText( s, "</mfenced>" ) )
+		{
+			while( ( *on != '\0' ) && !hasText( on, "<mfenced" ) )
+			{
+				++on;
+			}
+
+			n = putCoreFence( dest, n, on, " close='", ")" );
+			n = putText( dest, n, "</mrow>", 7 );
+			s += 10;
+		}
+		else
+		{
+			n = putText( dest, n, s++, 1 );
+		}
+	}
+
+	return n;
+}
+
+// writes table string s in 'style' to dest, if not NULL, and returns its
+// length; 'on' is the start tag of the record s is in
+
+constexpr size_t styleText( const char *s, const char *on, int style, char *dest )
+{
+	char core[STYLE_TEXT_SIZE] = {};
+	size_t len = 0;
+
+	if( style & STYLE_CORE )
+	{
+		len = coreText( s, on, core );
+		s	= core;
+	}
+	else
+	{
+		len = textLength( s );
+	}
+
+	if( style & STYLE_COMPACT )
+	{
+		return compactText( s, len, dest );
+	}
+
+	for( size_t i = 0; ( dest != NULL ) && ( i < len ); ++i )
+	{
+		dest[i] = s[i];
+	}
+
+	return len;
+}
+
+// the size a string that 'style' changes takes in its pool; 0 if it is
+// the same in that style
+
+constexpr size_t styleSize( const char *s, const char *on, int style )
+{
+	char text[STYLE_TEXT_SIZE] = {};
+	size_t len = styleText( s, on, style, text );
+
+	return ( ( len == textLength( s ) ) && hasText( s, text ) ) ? 0 : len + 1;
+}
+
+// the strings of the other tables that a style changes go to one pool
+// for the style; the offset of each, or UNCHANGED, is kept by table
+
+static constexpr size_t UNCHANGED = (size_t) -1;
+
+constexpr size_t stylePoolSize( int style )
+{
+	size_t size = 1;
+
+	for( size_t i = 0; i < TABLE_SIZE( commandTable ); ++i )
+	{
+		size += styleSize( commandTable[i].tagOn, commandTable[i].tagOn, style ) +
+				styleSize( commandTable[i].tagOff, commandTable[i].tagOn, style );
+	}
+
+	for( size_t i = 0; i < TABLE_SIZE( environmentTable ); ++i )
+	{
+		size += styleSize( environmentTable[i].tagOn, environmentTable[i].tagOn, style ) +
+				styleSize( environmentTable[i].tagOff, environmentTable[i].tagOn, style );
+	}
+
+	for( size_t i = 0; i < TABLE_SIZE( symbols ); ++i )
+	{
+		size += styleSize( symbols[i].literal, symbols[i].literal, style ) +
+				styleSize( symbols[i].element, symbols[i].element, style );
+	}
+
+	return size;
+}
+
+constexpr size_t maxStylePoolSize()
+{
+	size_t size = 0;
+
+	for( int style = 0; style < STYLE_COUNT; ++style )
+	{
+		if( stylePoolSize( style ) > size )
+		{
+			size = stylePoolSize( style );
+		}
+	}
+
+	return size;
+}
+
+struct StyleStrings {
+	char pool[maxStylePoolSize()];
+	size_t used;
+	size_t commandOn[TABLE_SIZE( commandTable )];
+	size_t commandOff[TABLE_SIZE( commandTable )];
+	size_t environmentOn[TABLE_SIZE( environmentTable )];
+	size_t environmentOff[TABLE_SIZE( environmentTable )];
+	size_t symbolLiteral[TABLE_SIZE( symbols )];
+	size_t symbolElement[TABLE_SIZE( symbols )];
+};
+
+constexpr size_t addStyleText( StyleStrings &strings, const char *s, const char *on, int style )
+{
+	size_t size = styleSize( s, on, style ), offset = strings.used;
+
+	if( size == 0 )
+	{
+		return UNCHANGED;
+	}
+
+	styleText( s, on, style, strings.pool + offset );	// the pool is zeroed
+	strings.used += size;
+
+	return offset;
+}
+
+constexpr StyleStrings makeStyleStrings( int style )
+{
+	StyleStrings strings = {};
+
+	for( size_t i = 0; i < TABLE_SIZE( commandTable ); ++i )
+	{
+		strings.commandOn[i]  = addStyleText( strings, commandTable[i].tagOn, commandTable[i].tagOn, style );
+		strings.commandOff[i] = addStyleText( strings, commandTable[i].tagOff, commandTable[i].tagOn, style );
+	}
+
+	for( size_t i = 0; i < TABLE_SIZE( environmentTable ); ++i )
+	{
+		strings.environmentOn[i]  = addStyleText( strings, environmentTable[i].tagOn, environmentTable[i].tagOn, style );
+		strings.environmentOff[i] = addStyleText( strings, environmentTable[i].tagOff, environmentTable[i].tagOn, style );
+	}
+
+	for( size_t i = 0; i < TABLE_SIZE( symbols ); ++i )
+	{
+		strings.symbolLiteral[i] = addStyleText( strings, symbols[i].literal, symbols[i].literal, style );
+		strings.symbolElement[i] = addStyleText( strings, symbols[i].element, symbols[i].element, style );
+	}
+
+	return strings;
+}
+
+static constexpr StyleStrings styleStrings[STYLE_COUNT] = {
+	makeStyleStrings( 0 ),
+	makeStyleStrings( STYLE_COMPACT ),
+	makeStyleStrings( STYLE_CORE ),
+	makeStyleStrings( STYLE_COMPACT | STYLE_CORE )
+};
+
+constexpr const char *styleString( int style, const char *s, size_t offset )
+{
+	return ( offset == UNCHANGED ) ? s : &styleStrings[style].pool[offset];
+}
+
+struct StyleTables {
+	CommandStruct command[TABLE_SIZE( commandTable )];
+	EnvironmentStruct environment[TABLE_SIZE( environmentTable )];
+	SymbolStruct symbol[TABLE_SIZE( symbols )];
+};
+
+constexpr StyleTables makeStyleTables( int style )
+{
+	StyleTables tables = {};
+	const StyleStrings &strings = styleStrings[style];
+
+	for( size_t i = 0; i < TABLE_SIZE( commandTable ); ++i )
+	{
+		tables.command[i] = { commandTable[i].name, commandTable[i].id, commandTable[i].param,
+							  styleString( style, commandTable[i].tagOn, strings.commandOn[i] ),
+							  styleString( style, commandTable[i].tagOff, strings.commandOff[i] ) };
+	}
+
+	for( size_t i = 0; i < TABLE_SIZE( environmentTable ); ++i )
+	{
+		tables.environment[i] = { environmentTable[i].name, environmentTable[i].id,
+								  styleString( style, environmentTable[i].tagOn, strings.environmentOn[i] ),
+								  styleString( style, environmentTable[i].tagOff, strings.environmentOff[i] ) };
+	}
+
+	for( size_t i = 0; i < TABLE_SIZE( symbols ); ++i )
+	{
+		tables.symbol[i] = { symbols[i].name,
+							 styleString( style, symbols[i].literal, strings.symbolLiteral[i] ),
+							 styleString( style, symbols[i].element, strings.symbolElement[i] ),
+							 symbols[i].mathType };
+	}
+
+	return tables;
+}
+
+static constexpr StyleTables styleTables[STYLE_COUNT] = {
+	makeStyleTables( 0 ),
+	makeStyleTables( STYLE_COMPACT ),
+	makeStyleTables( STYLE_CORE ),
+	makeStyleTables( STYLE_COMPACT | STYLE_CORE )
+};
+
+// the three control tables merged into one list of names
+
+struct ControlName {
+	const char *name;
+	token_type token;
+	const void *record;
+	const Fragment *element;
+	const Fragment *literal;
+};
+
+enum { CONTROL_NAME_COUNT = TABLE_SIZE( commandTable ) + TABLE_SIZE( entityTable ) + TABLE_SIZE( functionTable ) };
+
+struct ControlNameList {
+	ControlName name[CONTROL_NAME_COUNT];
+};
+
+constexpr ControlNameList makeControlNames( const CommandStruct *commands, const ControlFragments &fragments )
+{
+	ControlNameList list = {};
+	size_t n = 0;
+
+	for( size_t i = 0; i < TABLE_SIZE( commandTable ); ++i, ++n )
+	{
+		list.name[n] = { commands[i].name, token_control_command, &commands[i], NULL, NULL };
+	}
+
+	for( size_t i = 0; i < TABLE_SIZE( entityTable ); ++i, ++n )
+	{
+		list.name[n] = { entityTable[i].name, token_control_entity, &entityTable[i],
+						 &fragments.entityElement[i], &fragments.entityLiteral[i] };
+	}
+
+	for( size_t i = 0; i < TABLE_SIZE( functionTable ); ++i, ++n )
+	{
+		list.name[n] = { functionTable[i].name, token_control_function, &functionTable[i],
+						 &fragments.functionElement[i], &fragments.functionLiteral[i] };
+	}
+
+	return list;
+}
+
+static constexpr ControlNameList controlNames[STYLE_COUNT] = {
+	makeControlNames( styleTables[0].command, controlFragments ),
+	makeControlNames( styleTables[STYLE_COMPACT].command, compactFragments ),
+	makeControlNames( styleTables[STYLE_CORE].command, controlFragments ),
+	makeControlNames( styleTables[STYLE_COMPACT | STYLE_CORE].command, compactFragments )
+};
+
+static constexpr PerfectHash<512, 64> controlHash = buildHash<512, 64>( controlNames[0].name );
+static constexpr PerfectHash<16, 4> environmentHash = buildHash<16, 4>( environmentTable );
+static constexpr PerfectHash<128, 16> fenceHash = buildHash<128, 16>( fenceTable );
+
+
+// the tables of every style have the same names in the same order, so
+// one hash finds a name in any of them
+
+const ControlName *findControl( const char *name, int style )
+{
+	return findName( controlHash, controlNames[style].name, name );
+}
+
+token_type getControlType( const ControlName *found, ControlStruct &control )
+{
+	control.command = NULL;
+	control.entity  = NULL;
+	control.element = NULL;
+	control.literal = NULL;
+	control.token   = token_unknown;
+
+	if( found != NULL )
+	{
+		control.token   = found->token;
+		control.element = found->element;
+		control.literal = found->literal;
+
+		switch( found->token )
+		{
+		case token_control_command:
+			control.command = (const CommandStruct *) found->record;
+			break;
+		case token_control_entity:
+			control.entity = (const EntityStruct *) found->record;
+			break;
+		default:
+			control.function = (const FunctionStruct *) found->record;
+		}
+	}
+
+	return control.token;
+}
+
+token_type getControlType( const char *name, ControlStruct &control, int style )
+{
+	return getControlType( findControl( name, style ), control );
+}
+
+/*
+
+enum math_type { mt_unknown, mt_ident, mt_digit, mt_ord, mt_bin, mt_unary, mt_rel, mt_fence, 
+				 mt_mov_limits, mt_limits, mt_func, mt_func_limits, mt_text };
+*/
+
+const char *getErrorMsg( ex_exception code )
+{
+	const int size = TABLE_SIZE( errorTable );
+
+	for( int i = 0; i < size; ++i )
+	{
+		if( code == errorTable[i].code )
+		{
+			return errorTable[i].msg;
+		}
+	}	
+
+	return NULL;
+}
+
+const char *getMathVariant( const char *attrib )
+{
+	const int size = TABLE_SIZE( mathvariant );
+
+	int result, low, mid, high;
+
+	low = 0;
+	high = size - 1;
+
+	while( low <= high )
+	{
+		mid = ( low + high )/2;
+
+		result = fastCompare( attrib, mathvariant[mid].key );
+
+		if( result < 0 )
+		{
+			high = mid - 1;
+		}
+		else if( result > 0 )
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			return mathvariant[mid].value;			
+		}
+	}
+
+	return NULL;
+}
+
+
+bool getFenceType( const char *name,  FenceStruct &fence, int style )
+{
+	const FenceFragments &fragments = ( style & STYLE_COMPACT ) ? compactFenceFragments : fenceFragments;
+	size_t i;
+
+	fence.entity = findName( fenceHash, fenceTable, name );
+
+	if( fence.entity == NULL )
+	{
+		return false;
+	}
+
+	i = fence.entity - fenceTable;
+	fence.left	  = &fragments.left[i];
+	fence.right	  = &fragments.right[i];
+	fence.element = &fragments.element[i];
+
+	return true;		
+}
+
+
+
+const EnvironmentStruct *getEnvironmentType( const char *name, int style )
+{
+	return findName( environmentHash, styleTables[style].environment, name );
+}
+
+
+// symbols are found by direct indexing: one-character names by their
+// byte, control symbols such as \, by the byte after the backslash and
+// runs of primes by their length
+
+enum { SYMBOL_MAX_PRIMES = 3 };
+
+struct SymbolIndex {
+	signed char single[256];
+	signed char control[256];
+	signed char prime[SYMBOL_MAX_PRIMES + 1];
+};
+
+static_assert( TABLE_SIZE( symbols ) < 128, "too many symbols for SymbolIndex" );
+
+constexpr SymbolIndex buildSymbolIndex()
+{
+	SymbolIndex index = {};
+	signed char *entry = NULL;
+
+	for( size_t i = 0; i < 256; ++i )
+	{
+		index.single[i]  = -1;
+		index.control[i] = -1;
+	}
+
+	for( size_t i = 0; i <= SYMBOL_MAX_PRIMES; ++i )
+	{
+		index.prime[i] = -1;
+	}
+
+	for( size_t i = 0; i < TABLE_SIZE( symbols ); ++i )
+	{
+		const char *name = symbols[i].name;
+		size_t len = 0;
+
+		while( name[len] == '\'' )
+		{
+			++len;
+		}
+
+		if( ( len > 1 ) && ( name[len] == '\0' ) )
+		{
+			if( len > SYMBOL_MAX_PRIMES )
+			{
+				throw "too many primes in a symbol name";
+			}
+			entry = &index.prime[len];
+		}
+		else if( name[1] == '\0' )
+		{
+			entry = &index.single[ (unsigned char) name[0] ];
+		}
+		else if( ( name[0] == '\\' ) && ( name[2] == '\0' ) )
+		{
+			entry = &index.control[ (unsigned char) name[1] ];
+		}
+		else
+		{
+			throw "symbol name can't be indexed";		// not a constant expression: stops the build
+		}
+
+		if( *entry != -1 )
+		{
+			throw "duplicate symbol name";
+		}
+
+		*entry = (signed char) i;
+	}
+
+	return index;
+}
+
+static constexpr SymbolIndex symbolIndex = buildSymbolIndex();
+
+const SymbolStruct *getSymbol( const char *name, int style )
+{
+	const unsigned char *p = (const unsigned char *) name;
+	int i;
+
+	if( p[0] == '\0' )
+	{
+		return NULL;
+	}
+
+	if( p[1] == '\0' )
+	{
+		i = symbolIndex.single[ p[0] ];
+	}
+	else if( ( p[0] == '\\' ) && ( p[2] == '\0' ) )
+	{
+		i = symbolIndex.control[ p[1] ];
+	}
+	else
+	{
+		size_t len = strspn( name, "'" );
+
+		i = ( ( len <= SYMBOL_MAX_PRIMES ) && ( p[len] == '\0' ) ) ? symbolIndex.prime[len] : -1;
+	}
+
+	if( i < 0 )
+	{
+		return NULL;
+	}
+
+	return &styleTables[style].symbol[i];
+}
+
+
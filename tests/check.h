@@ -0,0 +1,21 @@
+/*
+//  Copyright (c) 2020 Peter Frane Jr. All Rights Reserved.
+//
+//  Use of this source code is governed by the GPL v. 3.0 license that can be
+//  found in the LICENSE file.
+//
+//  This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+//  OF ANY KIND, either express or implied.
+//
+//  For inquiries, email the author at pfranejr AT hotmail.com
+*/
+
+#pragma once
+#include <stdio.h>
+
+// each test is a program of its own; it prints the checks that fail and
+// exits with the number of failures
+
+static int failures = 0;
+
+#define CHECK( cond, what )	do { if( !(cond) ) { ++failures; printf( "%s:%d: %s: %s\n", __FILE__, __LINE__, #cond, what ); } } while( 0 )
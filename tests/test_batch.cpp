@@ -0,0 +1,129 @@
+/*
+//  Copyright (c) 2020 Peter Frane Jr. All Rights Reserved.
+//
+//  Use of this source code is governed by the GPL v. 3.0 license that can be
+//  found in the LICENSE file.
+//
+//  This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+//  OF ANY KIND, either express or implied.
+//
+//  For inquiries, email the author at pfranejr AT hotmail.com
+*/
+
+// fntex2mml_batch() must give every formula the result it gets when it
+// is converted on its own, whatever the number of threads
+
+#include "check.h"
+#include "../tex2mml.h"
+#include "../exceptions.h"
+
+#if defined( __linux__ ) && !defined( __SANITIZE_ADDRESS__ )
+#define LIMIT_ADDRESS_SPACE
+#include <sys/resource.h>
+#endif
+
+static const char *formulas[] = {
+	"\\frac 1 2 \\sqrt{ABc}",
+	"x^2 + y_1^{n+1}",
+	"\\left( \\sum_{i=0}^n a_i \\right)",
+	"\\begin{pmatrix} a & b \\\\ c & d \\end{pmatrix}",
+	"\\mathrm{sin} \\alpha \\eqno{(1)}",
+	"\\binom{n}{k} \\overbrace{a+b}",
+	"",
+	"{}",
+	"\\foo + 1",
+	"{a",
+	"a}",
+	"x^1^2",
+	"\\begin{array}{cc} 1 & 2 \\end{matrix}",
+	"\\frac{a}",
+};
+
+enum { COPIES = 300, FORMULA_COUNT = sizeof( formulas ) / sizeof( formulas[0] ) };
+
+int main()
+{
+	vector<const char *> inputs;
+	vector<FormulaResult> expected( COPIES * FORMULA_COUNT );
+	ConverterContext *ctx = createConverter();
+
+	for( size_t i = 0; i < expected.size(); ++i )
+	{
+		FormulaResult &r = expected[i];
+
+		inputs.push_back( formulas[i % FORMULA_COUNT] );
+		r.error_pos = 0;
+		r.ok = fntex2mml_r( ctx, inputs[i], r.output, &r.error_pos, i % 2 == 0, r.error_msg );
+	}
+	destroyConverter( ctx );
+
+	static const unsigned threadCounts[] = { 1, 4, 0 };
+
+	for( unsigned threads : threadCounts )
+	{
+		for( int display = 0; display < 2; ++display )
+		{
+			vector<FormulaResult> results;
+			bool allOk = fntex2mml_batch( inputs.data(), inputs.size(), results, display != 0, threads );
+
+			CHECK( !allOk, "the corpus has failing formulas" );
+			CHECK( results.size() == inputs.size(), "one result per formula" );
+
+			for( size_t i = 0; i < results.size() && i < inputs.size(); ++i )
+			{
+				const FormulaResult &r = results[i];
+				FormulaResult e = expected[i];
+
+				if( ( i % 2 == 0 ) != ( display != 0 ) )
+				{
+					e.error_pos = 0;
+					e.ok = fntex2mml( inputs[i], e.output, &e.error_pos, display != 0, e.error_msg );
+				}
+
+				CHECK( r.ok == e.ok, inputs[i] );
+				CHECK( r.output == e.output, inputs[i] );
+				CHECK( r.ok || r.error_msg == e.error_msg, inputs[i] );
+				CHECK( r.ok || r.error_pos == e.error_pos, inputs[i] );
+
+				if( r.ok )
+				{
+					CHECK( r.error_code == BATCH_CONVERTED, inputs[i] );
+				}
+				else if( !*inputs[i] || r.error_msg == "Empty" )
+				{
+					CHECK( r.error_code == BATCH_NOTHING_TO_CONVERT, inputs[i] );
+				}
+				else
+				{
+					CHECK( r.error_code >= ex_syntax_error, inputs[i] );
+				}
+			}
+		}
+	}
+
+	vector<FormulaResult> none;
+
+	CHECK( fntex2mml_batch( NULL, 0, none, false, 0 ), "an empty batch" );
+	CHECK( none.empty(), "an empty batch" );
+
+#ifdef LIMIT_ADDRESS_SPACE
+	// with too little address space for the stacks of the threads asked
+	// for, some of them can't be started; the batch still converts all
+
+	struct rlimit saved, limit;
+	vector<const char *> many( 4000, formulas[1] );
+	vector<FormulaResult> results;
+
+	getrlimit( RLIMIT_AS, &saved );
+	limit = saved;
+	limit.rlim_cur = (rlim_t) 2 << 30;
+	setrlimit( RLIMIT_AS, &limit );
+
+	CHECK( fntex2mml_batch( many.data(), many.size(), results, false, 1000 ), "threads that can't be started" );
+	CHECK( results.size() == many.size(), "threads that can't be started" );
+
+	setrlimit( RLIMIT_AS, &saved );
+#endif
+
+	return failures;
+}
@@ -0,0 +1,120 @@
+/*
+//  Copyright (c) 2020 Peter Frane Jr. All Rights Reserved.
+//
+//  Use of this source code is governed by the GPL v. 3.0 license that can be
+//  found in the LICENSE file.
+//
+//  This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+//  OF ANY KIND, either express or implied.
+//
+//  For inquiries, email the author at pfranejr AT hotmail.com
+*/
+
+// input nested up to the default limit must convert, and deeper input
+// fail with ex_nesting_too_deep, on a thread with a small stack: the
+// same at every level of optimization
+
+#include "check.h"
+#include "../tex2mml.h"
+#include "../exceptions.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+enum { SMALL_STACK = 128 * 1024 };
+
+struct Nesting {
+	const char *open, *close;
+};
+
+static const Nesting nestings[] = {
+	{ "{", "}" },
+	{ "\\sqrt{", "}" },
+	{ "\\sqrt[", "]{y}" },
+	{ "\\frac{x}{", "}" },
+	{ "\\frac{", "}{y}" },
+	{ "x^{", "}" },
+	{ "x_{", "}" },
+	{ "\\binom{", "}{k}" },
+	{ "\\cfrac{", "}{2}" },
+	{ "\\cfrac{1}{", "}" },
+	{ "\\overbrace{", "}" },
+	{ "\\overline{", "}" },
+	{ "\\left(", "\\right)" },
+	{ "\\begin{matrix}", "\\end{matrix}" },
+	{ "\\text{$", "$}" },
+};
+
+static const size_t depths[] = { 1, 10, 50, 100, 254, 1000, 5000 };
+
+static void *runTests( void * )
+{
+	ConverterContext *ctx = createConverter();
+
+	for( const Nesting &n : nestings )
+	{
+		for( size_t depth : depths )
+		{
+			string input, output;
+			size_t errorPos = 0;
+			int errorCode = -1;
+
+			for( size_t i = 0; i < depth; ++i )
+			{
+				input += n.open;
+			}
+			input += "x";
+			for( size_t i = 0; i < depth; ++i )
+			{
+				input += n.close;
+			}
+
+			bool ok = convertFormula( ctx, input.data(), input.size(), &errorPos, &errorCode ) && getMathMLOutput( ctx, output, false );
+
+			if( depth < NESTING_LIMIT_DEFAULT )
+			{
+				CHECK( ok, n.open );
+			}
+			else
+			{
+				CHECK( !ok && ( errorCode == ex_nesting_too_deep ), n.open );
+			}
+		}
+	}
+
+	destroyConverter( ctx );
+
+	return NULL;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI threadMain( LPVOID )
+{
+	runTests( NULL );
+	return 0;
+}
+#endif
+
+int main()
+{
+#ifdef _WIN32
+	HANDLE thread = CreateThread( NULL, SMALL_STACK, threadMain, NULL, STACK_SIZE_PARAM_IS_A_RESERVATION, NULL );
+
+	WaitForSingleObject( thread, INFINITE );
+	CloseHandle( thread );
+#else
+	pthread_attr_t attr;
+	pthread_t thread;
+
+	pthread_attr_init( &attr );
+	pthread_attr_setstacksize( &attr, SMALL_STACK );
+	pthread_create( &thread, &attr, runTests, NULL );
+	pthread_join( thread, NULL );
+	pthread_attr_destroy( &attr );
+#endif
+
+	return failures;
+}
@@ -0,0 +1,94 @@
+/*
+//  Copyright (c) 2020 Peter Frane Jr. All Rights Reserved.
+//
+//  Use of this source code is governed by the GPL v. 3.0 license that can be
+//  found in the LICENSE file.
+//
+//  This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+//  OF ANY KIND, either express or implied.
+//
+//  For inquiries, email the author at pfranejr AT hotmail.com
+*/
+
+// recovery mode must find every error of a formula, not only the first,
+// and go on converting after each
+
+#include "check.h"
+#include <string.h>
+#include "../tex2mml.h"
+#include "../exceptions.h"
+
+enum { MAX_ERRORS = 4 };
+
+struct ExpectedError {
+	size_t pos;
+	int code;
+};
+
+struct RecoveryCase {
+	const char *input;
+	size_t count;
+	ExpectedError errors[MAX_ERRORS];
+	const char *kept;	// output that must follow the errors
+};
+
+static const RecoveryCase cases[] = {
+	{ "\\foo + \\qux + \\baz", 3,
+	  { { 0, ex_undefined_control_sequence }, { 7, ex_undefined_control_sequence }, { 14, ex_undefined_control_sequence } },
+	  "<mo>+</mo><merror><mtext>\\baz</mtext></merror>" },
+	{ "a = \\foo \\\\ b = \\qux", 3,
+	  { { 4, ex_undefined_control_sequence }, { 9, ex_misplaced_row_separator }, { 16, ex_undefined_control_sequence } },
+	  "<mi>b</mi><mo>=</mo>" },
+	{ "a & b & c", 2,
+	  { { 2, ex_misplaced_column_separator }, { 6, ex_misplaced_column_separator } },
+	  "<mi>c</mi>" },
+	{ "\\foo{x} + y", 1,
+	  { { 0, ex_undefined_control_sequence } },
+	  "<mi>x</mi><mo>+</mo><mi>y</mi>" },
+	{ "x \xC3\xA9 y \xC3\xBC z", 2,
+	  { { 3, ex_unknown_character }, { 8, ex_unknown_character } },
+	  "<mi>z</mi>" },
+	{ "\\frac{\\foo}{\\qux} + \\baz", 3,
+	  { { 6, ex_undefined_control_sequence }, { 12, ex_undefined_control_sequence }, { 20, ex_undefined_control_sequence } },
+	  "</mfrac><mo>+</mo>" },
+	{ "\\mathbf{\\foo} + \\baz", 2,
+	  { { 8, ex_undefined_control_sequence }, { 16, ex_undefined_control_sequence } },
+	  "<mo>+</mo><merror><mtext>\\baz</mtext></merror>" },
+	{ "\\text{\\foo} c \\baz", 2,
+	  { { 6, ex_undefined_control_sequence }, { 14, ex_undefined_control_sequence } },
+	  "<mi>c</mi><merror><mtext>\\baz</mtext></merror>" },
+	{ "\\left(\\foo\\right) + \\baz", 2,
+	  { { 6, ex_undefined_control_sequence }, { 20, ex_undefined_control_sequence } },
+	  "<mo>+</mo><merror><mtext>\\baz</mtext></merror>" },
+	{ "\\begin{matrix} \\foo & \\qux \\\\ \\baz & 1 \\end{matrix}", 3,
+	  { { 15, ex_undefined_control_sequence }, { 22, ex_undefined_control_sequence }, { 30, ex_undefined_control_sequence } },
+	  "<mtd><mn>1</mn></mtd>" },
+	{ "a + b", 0, {}, "<mi>b</mi>" },
+};
+
+int main()
+{
+	ConverterContext *ctx = createConverter();
+
+	for( const RecoveryCase &c : cases )
+	{
+		vector<FormulaError> errors;
+		bool ok = convertFormula( ctx, c.input, INPUT_NUL_TERMINATED, errors );
+		const char *output = getMathMLOutput( ctx );
+
+		CHECK( ok == ( c.count == 0 ), c.input );
+		CHECK( errors.size() == c.count, c.input );
+
+		for( size_t i = 0; ( i < errors.size() ) && ( i < c.count ); ++i )
+		{
+			CHECK( errors[i].pos == c.errors[i].pos, c.input );
+			CHECK( errors[i].code == c.errors[i].code, c.input );
+		}
+
+		CHECK( ( output != NULL ) && ( strstr( output, c.kept ) != NULL ), c.input );
+	}
+
+	destroyConverter( ctx );
+
+	return failures;
+}
@@ -0,0 +1,111 @@
+/*
+//  Copyright (c) 2020 Peter Frane Jr. All Rights Reserved.
+//
+//  Use of this source code is governed by the GPL v. 3.0 license that can be
+//  found in the LICENSE file.
+//
+//  This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+//  OF ANY KIND, either express or implied.
+//
+//  For inquiries, email the author at pfranejr AT hotmail.com
+*/
+
+// what an output sink receives must be the document getMathMLOutput()
+// returns for the same formula, and a large table must reach the sink
+// in pieces while it is parsed
+
+#include "check.h"
+#include "../tex2mml.h"
+
+struct Received {
+	string text;
+	size_t chunks;
+};
+
+static void sink( void *user, const char *text, size_t len )
+{
+	Received *received = (Received *) user;
+
+	received->text.append( text, len );
+	++received->chunks;
+}
+
+// a table of 'rows' rows with braces, scripts and fractions in each
+// row, between 'before' and 'after'
+
+static string table( const char *before, size_t rows, const char *after )
+{
+	string s( before );
+	char row[96];
+
+	s += "\\begin{array}{ccc}";
+	for( size_t i = 0; i < rows; ++i )
+	{
+		snprintf( row, sizeof( row ), "x_{%zu}+1&\\frac{a}{b}&{\\sqrt{%zu}}\\\\", i, i );
+		s += row;
+	}
+	s += "\\end{array}";
+	s += after;
+
+	return s;
+}
+
+int main()
+{
+	ConverterContext *ctx = createConverter();
+	vector<string> inputs = {
+		"\\frac 1 2 \\sqrt{ABc}",
+		"\\begin{pmatrix} a & b \\\\ c & d \\end{pmatrix}",
+		"a + \\begin{matrix} 1 \\\\ 2 \\end{matrix} + b",
+		"\\begin{matrix} 1 \\\\ 2 \\end{matrix}^2",
+		"\\foo",
+		table( "", 20000, "" ),
+		table( "y = ", 20000, " + z" ),
+		table( "\\text{eqno} = ", 20000, "" ),
+		table( "", 20000, "\\eqno(1)" ),
+		table( "\\leqno{1} ", 20000, "" ),
+		table( "", 20000, " + " ) + table( "", 20000, "\\eqno(2)" ),
+		table( "{", 20000, "}" ),
+	};
+
+	for( const string &input : inputs )
+	{
+		for( int display = 0; display < 2; ++display )
+		{
+			size_t errorPos, streamErrorPos;
+			int errorCode, streamErrorCode;
+			string expected;
+			Received received;
+
+			received.chunks = 0;
+
+			bool ok = convertFormula( ctx, input.data(), input.size(), &errorPos, &errorCode ) && getMathMLOutput( ctx, expected, display != 0 );
+			bool streamOk = convertFormula( ctx, input.data(), input.size(), display != 0, sink, &received, &streamErrorPos, &streamErrorCode );
+
+			CHECK( ok == streamOk, input.substr( 0, 60 ).c_str() );
+
+			if( ok && streamOk )
+			{
+				CHECK( received.text == expected, input.substr( 0, 60 ).c_str() );
+			}
+			else if( !ok && !streamOk )
+			{
+				CHECK( ( errorPos == streamErrorPos ) && ( errorCode == streamErrorCode ), input.substr( 0, 60 ).c_str() );
+			}
+
+			// a top-level table goes out in blocks of rows, unless an
+			// equation number wraps the formula
+
+			if( input.size() > 100000 )
+			{
+				bool numbered = ( input.find( "\\eqno" ) != string::npos ) || ( input.find( "\\leqno" ) != string::npos ) || ( input[0] == '{' );
+
+				CHECK( numbered == ( received.chunks < 10 ), input.substr( input.size() - 20 ).c_str() );
+			}
+		}
+	}
+
+	destroyConverter( ctx );
+
+	return failures;
+}
@@ -1,49 +1,202 @@
-/*
-//  Copyright (c) 2020 Peter Frane Jr. All Rights Reserved.
-//
-//  Use of this source code is governed by the GPL v. 3.0 license that can be
-//  found in the LICENSE file.
-//
-//  This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
-//  OF ANY KIND, either express or implied.
-//
-//  For inquiries, email the author at pfranejr AT hotmail.com
-*/
-
-#include "tex2mml.h"
-
-bool fntex2mml(const char* input, string& output, int* error_pos, bool display_style, string& error_msg)
-{
-	if (!input)
-	{
-		error_msg = "Nothing to convert";
-
-		return false;
-	}
-	else
-	{
-		int error_code;
-
-		if (convertFormula(input, -1, error_pos, &error_code))
-		{
-			if (getMathMLOutput(output, display_style))
-			{
-				error_msg.clear();
-
-				return true;
-			}
-			else
-			{
-				error_msg = "Empty";
-
-				return false;
-			}
-		}
-		else
-		{
-			error_msg = getLastError();
-
-			return false;
-		}
-	}
-}
+/*
+//  Copyright (c) 2020 Peter Frane Jr. All Rights Reserved.
+//
+//  Use of this source code is governed by the GPL v. 3.0 license that can be
+//  found in the LICENSE file.
+//
+//  This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+//  OF ANY KIND, either express or implied.
+//
+//  For inquiries, email the author at pfranejr AT hotmail.com
+*/
+
+#include "tex2mml.h"
+#include "tables.h"
+#include <thread>
+#include <atomic>
+
+bool fntex2mml_r(ConverterContext* ctx, const char* input, string& output, size_t* error_pos, bool display_style, string& error_msg)
+{
+	if (!input || !*input)
+	{
+		error_msg = "Nothing to convert";
+
+		return false;
+	}
+	else
+	{
+		int error_code;
+
+		if (convertFormula(ctx, input, INPUT_NUL_TERMINATED, error_pos, &error_code))
+		{
+			if (getMathMLOutput(ctx, output, display_style))
+			{
+				error_msg.clear();
+
+				return true;
+			}
+			else
+			{
+				error_msg = "Empty";
+
+				return false;
+			}
+		}
+		else
+		{
+			error_msg = getLastError(ctx);
+
+			return false;
+		}
+	}
+}
+
+bool fntex2mml(const char* input, string& output, size_t* error_pos, bool display_style, string& error_msg)
+{
+	return fntex2mml_r(NULL, input, output, error_pos, display_style, error_msg);
+}
+
+static void convertBatchItem(ConverterContext* ctx, const char* input, FormulaResult& result, bool display_style)
+{
+	result.error_code = BATCH_NOTHING_TO_CONVERT;
+	result.error_pos = 0;
+
+	if (!input || !*input)
+	{
+		result.error_msg = "Nothing to convert";
+		result.ok = false;
+	}
+	else if (convertFormula(ctx, input, INPUT_NUL_TERMINATED, &result.error_pos, &result.error_code))
+	{
+		result.ok = getMathMLOutput(ctx, result.output, display_style);
+
+		if (result.ok)
+		{
+			result.error_code = BATCH_CONVERTED;
+		}
+		else
+		{
+			result.error_code = BATCH_NOTHING_TO_CONVERT;
+			result.error_msg = "Empty";
+		}
+	}
+	else
+	{
+		result.error_msg = getLastError(ctx);
+		result.ok = false;
+	}
+}
+
+static void batchFailure(FormulaResult& result, ex_exception code)
+{
+	result.ok = false;
+	result.output.clear();
+	result.error_code = code;
+	result.error_msg = getErrorMsg(code);
+}
+
+static void batchWorker(const char* const* inputs, size_t count, vector<FormulaResult>* results, bool display_style, atomic<size_t>* next)
+{
+	ConverterContext* ctx = NULL;
+	size_t i;
+
+	// items are handed out one at a time so that a few long formulas
+	// don't leave the other workers idle. An exception fails only the
+	// item that raised it; it must not leave the thread, where it would
+	// end the whole process
+
+	while ((i = next->fetch_add(1)) < count)
+	{
+		FormulaResult& result = (*results)[i];
+		bool thrown = true;
+
+		try
+		{
+			if (!ctx)
+			{
+				ctx = createConverter();
+			}
+			convertBatchItem(ctx, inputs[i], result, display_style);
+			thrown = false;
+		}
+		catch (ex_exception code)
+		{
+			batchFailure(result, code);
+		}
+		catch (const bad_alloc&)
+		{
+			batchFailure(result, ex_out_of_memory);
+		}
+		catch (...)
+		{
+			batchFailure(result, ex_internal_error);
+		}
+
+		if (thrown && ctx)
+		{
+			// the conversion stopped halfway; start the next one on a fresh context
+
+			destroyConverter(ctx);
+			ctx = NULL;
+		}
+	}
+
+	destroyConverter(ctx);
+}
+
+bool fntex2mml_batch(const char* const* inputs, size_t count, vector<FormulaResult>& results, bool display_style, unsigned threads)
+{
+	vector<thread> pool;
+	atomic<size_t> next(0);
+
+	results.clear();
+	results.resize(count);
+
+	if (threads == 0)
+	{
+		threads = thread::hardware_concurrency();
+	}
+	if (threads > count)
+	{
+		threads = (unsigned)count;
+	}
+
+	if (threads <= 1)
+	{
+		batchWorker(inputs, count, &results, display_style, &next);
+	}
+	else
+	{
+		// a thread that can't be started throws; the threads already
+		// running must still be joined, or their destructors end the
+		// process. This thread then shares out the rest with them
+
+		try
+		{
+			pool.reserve(threads);
+
+			for (unsigned i = 0; i < threads; ++i)
+			{
+				pool.emplace_back(batchWorker, inputs, count, &results, display_style, &next);
+			}
+		}
+		catch (...)
+		{
+			batchWorker(inputs, count, &results, display_style, &next);
+		}
+
+		for (size_t i = 0; i < pool.size(); ++i)
+		{
+			pool[i].join();
+		}
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (!results[i].ok)
+		{
+			return false;
+		}
+	}
+	return true;
+}
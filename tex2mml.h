@@ -1,26 +1,138 @@
-/*
-//  Copyright (c) 2020 Peter Frane Jr. All Rights Reserved.
-//
-//  Use of this source code is governed by the GPL v. 3.0 license that can be
-//  found in the LICENSE file.
-//
-//  This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
-//  OF ANY KIND, either express or implied.
-//
-//  For inquiries, email the author at pfranejr AT hotmail.com
-*/
-
-#pragma once
-#include <string>
-
-using namespace std;
-
-bool convertFormula( const char *input, int len, int *errorIndex, int *errCode );
-const char *getMathMLOutput();
-bool getMathMLOutput(string &buf, bool display);
-const char *getLastError();
-
-extern "C"
-{
-	bool fntex2mml(const char* input, string& output, int* error_pos, bool display_style, string& error_msg);
+/*
+//  Copyright (c) 2020 Peter Frane Jr. All Rights Reserved.
+//
+//  Use of this source code is governed by the GPL v. 3.0 license that can be
+//  found in the LICENSE file.
+//
+//  This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+//  OF ANY KIND, either express or implied.
+//
+//  For inquiries, email the author at pfranejr AT hotmail.com
+*/
+
+#pragma once
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Holds the input cursor, the output and the last error of a conversion.
+// Use one context per thread. Passing NULL, or calling the functions
+// without a context argument, selects a default context private to the
+// calling thread.
+
+struct ConverterContext;
+
+// hugePages backs the scratch memory with 2MB pages where the OS allows it
+ConverterContext *createConverter( bool hugePages = false );
+void destroyConverter( ConverterContext *ctx );
+
+// the input is 'len' bytes and needn't be null-terminated; pass
+// INPUT_NUL_TERMINATED to have the length taken with strlen()
+
+#define INPUT_NUL_TERMINATED	((size_t) -1)
+
+// a formula with more than 'limit' groups open inside one another fails
+// with ex_nesting_too_deep; the default is TeX's own limit. Braces and
+// command arguments (\frac{...}) alike nest on a stack in the scratch
+// memory, so the depth takes none of the thread's stack
+
+#define NESTING_LIMIT_DEFAULT	255
+
+void setNestingLimit( ConverterContext *ctx, size_t limit );
+
+// compact output writes characters as UTF-8 rather than as references
+// (&#x3b1;), except for those XML must have escaped, and leaves out
+// attributes that restate the default: mathsize='1' on fences, and
+// mathvariant='normal' on an <mi> of more than one character. Off by default
+
+void setCompactOutput( ConverterContext *ctx, bool compact );
+
+// the MathML written: MathML 3, the default, or MathML Core, which
+// browsers render natively. MathML Core has no <mfenced>, so \left,
+// \binom and the fenced matrices (pmatrix, cases, ...) become an <mrow>
+// with their fences as <mo fence='true'>s. The dialect holds for the
+// conversions that follow
+
+enum output_dialect { dialect_mathml3, dialect_mathml_core };
+
+void setOutputDialect( ConverterContext *ctx, output_dialect dialect );
+
+bool convertFormula( ConverterContext *ctx, const char *input, size_t len, size_t *errorIndex, int *errCode );
+const char *getMathMLOutput( ConverterContext *ctx );
+bool getMathMLOutput( ConverterContext *ctx, string &buf, bool display );
+const char *getLastError( ConverterContext *ctx );
+
+bool convertFormula( const char *input, size_t len, size_t *errorIndex, int *errCode );
+const char *getMathMLOutput();
+bool getMathMLOutput(string &buf, bool display);
+const char *getLastError();
+
+// writes the document, <math> element included, to memory the caller owns
+// and returns its length, or 0 if there is no output. Nothing is written
+// unless 'size' holds all of it: pass 0 (buf may be NULL) to get the size
+// first. A null follows the text if there is room for it
+
+size_t getMathMLOutput( ConverterContext *ctx, char *buf, size_t size, bool display );
+size_t getMathMLOutput( char *buf, size_t size, bool display );
+
+// hands over the document, <math> element included and null-terminated,
+// in a block the caller frees with free(); NULL if there is no output.
+// Its length goes in *len. Until then the output is a tree in the
+// scratch memory; it is written once, straight into the block. The other
+// output functions return nothing until the next conversion
+
+char *releaseMathMLOutput( ConverterContext *ctx, bool display, size_t *len = NULL );
+char *releaseMathMLOutput( bool display, size_t *len = NULL );
+
+// recovery mode: the conversion goes on after an error and lists every
+// error it finds, in the order of the input. The output, if any, has the
+// source the parser had to skip as an <merror>. A formula nested too
+// deeply still fails with nothing written
+
+struct FormulaError {
+	int code;		// an ex_exception value
+	size_t pos;		// the offset of the error in the input
+	string msg;
+};
+
+bool convertFormula( ConverterContext *ctx, const char *input, size_t len, vector<FormulaError> &errors );
+
+// streaming: the sink receives the document, <math> element included, in
+// order and a chunk at a time. A table at the top level goes out a block
+// of rows at a time while it is parsed, so the output of a large one is
+// neither held whole nor waited for; the rest goes out at the end, and so
+// does all of a formula with \eqno, whose label is written first. If the
+// conversion fails, what the sink got is incomplete. The output functions
+// have nothing to return after this conversion
+
+typedef void (*OutputSink)( void *user, const char *text, size_t len );
+
+bool convertFormula( ConverterContext *ctx, const char *input, size_t len, bool display, OutputSink sink, void *user, size_t *errorIndex, int *errCode );
+
+// result of one formula of a batch; error_code is BATCH_CONVERTED when
+// 'output' holds the MathML, BATCH_NOTHING_TO_CONVERT for an empty input
+// or formula, or else the ex_exception value of the failure, and
+// error_pos the offset of the error in the input
+
+#define BATCH_NOTHING_TO_CONVERT	(-1)
+#define BATCH_CONVERTED				(-2)
+
+struct FormulaResult {
+	bool ok;
+	string output;
+	string error_msg;
+	int error_code;
+	size_t error_pos;
+};
+
+extern "C"
+{
+	bool fntex2mml(const char* input, string& output, size_t* error_pos, bool display_style, string& error_msg);
+	bool fntex2mml_r(ConverterContext* ctx, const char* input, string& output, size_t* error_pos, bool display_style, string& error_msg);
+
+	// converts 'count' formulas on 'threads' worker threads (0 = one per core);
+	// results[i] belongs to inputs[i] and a failed formula doesn't stop the others.
+	// returns true if every formula was converted
+	bool fntex2mml_batch(const char* const* inputs, size_t count, vector<FormulaResult>& results, bool display_style, unsigned threads);
 }
\ No newline at end of file